@@ -0,0 +1,58 @@
+#version 330 core
+
+// FXAA (Lottes) sampled from the low-resolution scene target, so the
+// upscale and anti-aliasing happen in one pass
+
+in vec2 TexCoords;
+
+out vec4 FragColor;
+
+uniform sampler2D screenTexture;
+uniform vec2 inverseScreenSize;
+
+const float FXAA_SPAN_MAX = 8.0;
+const float FXAA_REDUCE_MUL = 1.0 / 8.0;
+const float FXAA_REDUCE_MIN = 1.0 / 128.0;
+
+void main() {
+    vec3 luma = vec3(0.299, 0.587, 0.114);
+    vec2 px = inverseScreenSize;
+
+    vec3 rgbNW = texture(screenTexture, TexCoords + vec2(-1.0, -1.0) * px).rgb;
+    vec3 rgbNE = texture(screenTexture, TexCoords + vec2( 1.0, -1.0) * px).rgb;
+    vec3 rgbSW = texture(screenTexture, TexCoords + vec2(-1.0,  1.0) * px).rgb;
+    vec3 rgbSE = texture(screenTexture, TexCoords + vec2( 1.0,  1.0) * px).rgb;
+    vec3 rgbM  = texture(screenTexture, TexCoords).rgb;
+
+    float lumaNW = dot(rgbNW, luma);
+    float lumaNE = dot(rgbNE, luma);
+    float lumaSW = dot(rgbSW, luma);
+    float lumaSE = dot(rgbSE, luma);
+    float lumaM  = dot(rgbM, luma);
+
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    // Edge direction
+    vec2 dir;
+    dir.x = -((lumaNW + lumaNE) - (lumaSW + lumaSE));
+    dir.y =  ((lumaNW + lumaSW) - (lumaNE + lumaSE));
+
+    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE)
+        * (0.25 * FXAA_REDUCE_MUL), FXAA_REDUCE_MIN);
+    float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+    dir = clamp(dir * rcpDirMin, vec2(-FXAA_SPAN_MAX), vec2(FXAA_SPAN_MAX)) * px;
+
+    vec3 rgbA = 0.5 * (
+        texture(screenTexture, TexCoords + dir * (1.0 / 3.0 - 0.5)).rgb +
+        texture(screenTexture, TexCoords + dir * (2.0 / 3.0 - 0.5)).rgb);
+    vec3 rgbB = rgbA * 0.5 + 0.25 * (
+        texture(screenTexture, TexCoords + dir * -0.5).rgb +
+        texture(screenTexture, TexCoords + dir * 0.5).rgb);
+
+    float lumaB = dot(rgbB, luma);
+    if (lumaB < lumaMin || lumaB > lumaMax)
+        FragColor = vec4(rgbA, 1.0);
+    else
+        FragColor = vec4(rgbB, 1.0);
+}
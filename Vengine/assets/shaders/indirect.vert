@@ -0,0 +1,40 @@
+#version 430 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in uint aDrawID;
+
+struct DrawInfo {
+    vec4 sphere;
+    uint indexCount;
+    uint firstIndex;
+    int baseVertex;
+    uint instance;
+};
+
+layout (std430, binding = 0) readonly buffer Draws { DrawInfo draws[]; };
+struct Transform {
+    mat4 model;
+    mat3 normal;    // transpose(inverse(mat3(model))), built on the CPU
+};
+
+layout (std430, binding = 1) readonly buffer Transforms { Transform transforms[]; };
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main() {
+    Transform transform = transforms[draws[aDrawID].instance];
+    mat4 model = transform.model;
+
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    Normal = transform.normal * aNormal;
+    TexCoords = aTexCoords;
+    
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
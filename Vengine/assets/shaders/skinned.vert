@@ -0,0 +1,37 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 6) in uvec4 aBoneIds;
+layout (location = 7) in vec4 aBoneWeights;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+// Must match MAX_BONES in Animation.h
+layout (std140) uniform Bones { mat4 bones[128]; };
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat3 normalMatrix;
+
+void main() {
+    // Vertices without weights follow the mesh rigidly
+    mat4 skin = mat4(1.0);
+    if (dot(aBoneWeights, vec4(1.0)) > 0.0) {
+        skin = bones[aBoneIds.x] * aBoneWeights.x
+            + bones[aBoneIds.y] * aBoneWeights.y
+            + bones[aBoneIds.z] * aBoneWeights.z
+            + bones[aBoneIds.w] * aBoneWeights.w;
+    }
+
+    vec4 position = skin * vec4(aPos, 1.0);
+    FragPos = vec3(model * position);
+    Normal = normalMatrix * (mat3(skin) * aNormal);
+    TexCoords = aTexCoords;
+    
+    gl_Position = projection * view * model * position;
+}
@@ -0,0 +1,70 @@
+#include "AllocationCheck.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+namespace {
+    std::atomic<size_t> allocationCount{ 0 };
+}
+
+// Counting replacements of the global allocation functions; the array
+// and nothrow forms forward to these
+void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+AllocationCheck::AllocationCheck(int phaseCount, int warmupFrames,
+    int frames)
+    : m_phaseCount(phaseCount),
+    m_warmupFrames(warmupFrames),
+    m_frames(frames)
+{
+    // Recording a phase must not count as an allocation of the next one
+    m_allocations.reserve(phaseCount);
+}
+
+size_t AllocationCheck::getAllocationCount() {
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+int AllocationCheck::beginFrame() {
+    int phaseLength = m_warmupFrames + m_frames;
+    int phase = m_frame / phaseLength;
+    int frame = m_frame % phaseLength;
+    size_t count = getAllocationCount();
+
+    // The previous frame closed the measured range of its phase
+    if (frame == 0 && m_frame > 0) m_allocations.push_back(count - m_start);
+    if (frame == m_warmupFrames) m_start = count;
+
+    if (phase >= m_phaseCount) return -1;
+    m_frame++;
+    return phase;
+}
+
+int AllocationCheck::report() const {
+    bool ok = (int)m_allocations.size() == m_phaseCount;
+    for (size_t i = 0; i < m_allocations.size(); i++) {
+        std::cout << "Allocation check, phase " << i << ": "
+            << m_allocations[i] << " allocations in " << m_frames
+            << " frames after " << m_warmupFrames << " warm-up"
+            << std::endl;
+        ok = ok && m_allocations[i] == 0;
+    }
+    if ((int)m_allocations.size() < m_phaseCount)
+        std::cout << "Allocation check: window closed early" << std::endl;
+    std::cout << "Allocation check " << (ok ? "passed" : "FAILED")
+        << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Only in the AllocCheck project (VENGINE_ALLOCATION_CHECK), which
+// replaces the global operator new by a counting one. The main loop runs
+// a fixed number of frames per phase (one per draw path); each phase
+// warms up, then its frames must not touch the heap. Run the Release
+// configuration: debug iterators allocate on their own.
+class AllocationCheck {
+public:
+    explicit AllocationCheck(int phaseCount, int warmupFrames = 60,
+        int frames = 600);
+
+    // Phase of the frame about to start, -1 once every phase is done
+    int beginFrame();
+    // Prints the allocations of each phase; returns the exit code
+    int report() const;
+
+    // Heap allocations of the whole process so far
+    static size_t getAllocationCount();
+
+private:
+    int m_phaseCount;
+    int m_warmupFrames;
+    int m_frames;
+
+    int m_frame = 0;
+    size_t m_start = 0;
+    std::vector<size_t> m_allocations;   // per finished phase
+};
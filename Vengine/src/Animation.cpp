@@ -0,0 +1,420 @@
+#include "Animation.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VENGINE_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+    const size_t INSTANCE_GRAIN = 16;
+    // Rotation keys closer than this to the first key make a constant track
+    const float CONSTANT_ROTATION = 1e-4f;
+    const float CONSTANT_RANGE = 1e-6f;
+
+    template <typename T, typename Lerp>
+    T sampleKeys(const std::vector<float>& times, const std::vector<T>& values,
+        float time, Lerp lerp) {
+        size_t count = std::min(times.size(), values.size());
+        if (count == 1 || time <= times[0]) return values[0];
+        if (time >= times[count - 1]) return values[count - 1];
+
+        size_t i = std::upper_bound(times.begin(), times.begin() + count,
+            time) - times.begin();
+        float span = times[i] - times[i - 1];
+        float t = span > 0.0f ? (time - times[i - 1]) / span : 0.0f;
+        return lerp(values[i - 1], values[i], t);
+    }
+
+    glm::vec3 lerpVector(const glm::vec3& a, const glm::vec3& b, float t) {
+        return a + (b - a) * t;
+    }
+
+    glm::vec4 nlerpRotation(const glm::vec4& a, const glm::vec4& b, float t) {
+        glm::vec4 target = glm::dot(a, b) < 0.0f ? -b : b;
+        glm::vec4 q = a + (target - a) * t;
+        return q / std::sqrt(glm::dot(q, q));
+    }
+
+    float wrapTime(float time, float duration) {
+        if (duration <= 0.0f) return 0.0f;
+        time = std::fmod(time, duration);
+        return time < 0.0f ? time + duration : time;
+    }
+
+    // Column-major TRS matrix; the quaternion need not be normalized
+    void composeMatrix(const glm::vec4& t, const glm::vec4& q,
+        const glm::vec4& s, glm::mat4& m) {
+        float lengthSq = glm::dot(q, q);
+        float k = lengthSq > 0.0f ? 2.0f / lengthSq : 0.0f;
+        float xx = q.x * q.x * k, yy = q.y * q.y * k, zz = q.z * q.z * k;
+        float xy = q.x * q.y * k, xz = q.x * q.z * k, yz = q.y * q.z * k;
+        float wx = q.w * q.x * k, wy = q.w * q.y * k, wz = q.w * q.z * k;
+
+        m[0] = glm::vec4(1.0f - yy - zz, xy + wz, xz - wy, 0.0f) * s.x;
+        m[1] = glm::vec4(xy - wz, 1.0f - xx - zz, yz + wx, 0.0f) * s.y;
+        m[2] = glm::vec4(xz + wy, yz - wx, 1.0f - xx - yy, 0.0f) * s.z;
+        m[3] = glm::vec4(t.x, t.y, t.z, 1.0f);
+    }
+
+    // out = a * b; out may alias b but not a
+    void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+#ifdef VENGINE_SSE
+        __m128 c0 = _mm_loadu_ps(&a[0].x);
+        __m128 c1 = _mm_loadu_ps(&a[1].x);
+        __m128 c2 = _mm_loadu_ps(&a[2].x);
+        __m128 c3 = _mm_loadu_ps(&a[3].x);
+        for (int i = 0; i < 4; i++) {
+            __m128 r = _mm_mul_ps(c0, _mm_set1_ps(b[i].x));
+            r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(b[i].y)));
+            r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(b[i].z)));
+            r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_set1_ps(b[i].w)));
+            _mm_storeu_ps(&out[i].x, r);
+        }
+#else
+        out = a * b;
+#endif
+    }
+
+#ifdef VENGINE_SSE
+    // Four int16 -> float, sign extended
+    inline __m128 loadRotation(const int16_t* key) {
+        __m128i raw = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(key));
+        return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(raw, raw),
+            16));
+    }
+
+    // Four uint16 -> float; the fourth belongs to the next key
+    inline __m128 loadVector(const uint16_t* key) {
+        __m128i raw = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(key));
+        return _mm_cvtepi32_ps(_mm_unpacklo_epi16(raw,
+            _mm_setzero_si128()));
+    }
+#endif
+}
+
+void LocalPose::resize(size_t jointCount) {
+    translations.resize(jointCount);
+    rotations.resize(jointCount);
+    scales.resize(jointCount);
+}
+
+int Skeleton::findJoint(const std::string& name) const {
+    for (size_t i = 0; i < jointNames.size(); i++) {
+        if (jointNames[i] == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+AnimationClip AnimationClip::build(const std::string& name, float duration,
+    const Skeleton& skeleton, const std::vector<JointKeys>& keys,
+    float sampleRate) {
+    AnimationClip clip;
+    clip.name = name;
+    clip.m_duration = std::max(duration, 0.0f);
+    clip.m_sampleRate = sampleRate;
+    clip.m_frameCount = static_cast<uint32_t>(
+        std::ceil(clip.m_duration * sampleRate)) + 1;
+
+    size_t jointCount = skeleton.getJointCount();
+    std::vector<glm::vec3> translations(clip.m_frameCount);
+    std::vector<glm::vec4> rotations(clip.m_frameCount);
+    std::vector<glm::vec3> scales(clip.m_frameCount);
+
+    for (size_t j = 0; j < jointCount; j++) {
+        const JointKeys* joint = j < keys.size() ? &keys[j] : nullptr;
+        const LocalPose& bind = skeleton.bindPose;
+
+        for (uint32_t f = 0; f < clip.m_frameCount; f++) {
+            float time = std::min(f / sampleRate, clip.m_duration);
+
+            if (joint && !joint->translations.empty()) {
+                translations[f] = sampleKeys(joint->translationTimes,
+                    joint->translations, time, lerpVector);
+            }
+            else {
+                translations[f] = glm::vec3(bind.translations[j]);
+            }
+
+            if (joint && !joint->rotations.empty()) {
+                rotations[f] = sampleKeys(joint->rotationTimes,
+                    joint->rotations, time, nlerpRotation);
+            }
+            else {
+                rotations[f] = bind.rotations[j];
+            }
+            // Neighbouring keys on the same hemisphere, so that linear
+            // interpolation between them takes the short arc
+            if (f > 0 && glm::dot(rotations[f - 1], rotations[f]) < 0.0f)
+                rotations[f] = -rotations[f];
+
+            if (joint && !joint->scales.empty()) {
+                scales[f] = sampleKeys(joint->scaleTimes, joint->scales,
+                    time, lerpVector);
+            }
+            else {
+                scales[f] = glm::vec3(bind.scales[j]);
+            }
+        }
+
+        // Rotations: unit quaternion components in [-1, 1] as int16
+        Track rotation;
+        rotation.offset = static_cast<uint32_t>(clip.m_rotationData.size());
+        rotation.keyCount = 1;
+        for (uint32_t f = 1; f < clip.m_frameCount; f++) {
+            glm::vec4 d = glm::abs(rotations[f] - rotations[0]);
+            if (std::max(std::max(d.x, d.y), std::max(d.z, d.w))
+                > CONSTANT_ROTATION) {
+                rotation.keyCount = clip.m_frameCount;
+                break;
+            }
+        }
+        for (uint32_t f = 0; f < rotation.keyCount; f++) {
+            glm::vec4 q = rotations[f] / std::sqrt(glm::dot(rotations[f],
+                rotations[f]));
+            for (int c = 0; c < 4; c++) {
+                clip.m_rotationData.push_back(static_cast<int16_t>(
+                    std::lround(glm::clamp(q[c], -1.0f, 1.0f) * 32767.0f)));
+            }
+        }
+        clip.m_rotations.push_back(rotation);
+
+        clip.addRangeTrack(translations, clip.m_translations);
+        clip.addRangeTrack(scales, clip.m_scales);
+    }
+
+    clip.m_vectorData.push_back(0);
+    return clip;
+}
+
+void AnimationClip::addRangeTrack(const std::vector<glm::vec3>& values,
+    std::vector<RangeTrack>& tracks) {
+    glm::vec3 low = values[0], high = values[0];
+    for (const auto& value : values) {
+        low = glm::min(low, value);
+        high = glm::max(high, value);
+    }
+    glm::vec3 extent = high - low;
+
+    RangeTrack track;
+    track.offset = static_cast<uint32_t>(m_vectorData.size());
+    track.keyCount = std::max(std::max(extent.x, extent.y), extent.z)
+        > CONSTANT_RANGE ? static_cast<uint32_t>(values.size()) : 1;
+    track.min = glm::vec4(low, 0.0f);
+    track.scale = glm::vec4(extent / 65535.0f, 0.0f);
+
+    for (uint32_t k = 0; k < track.keyCount; k++) {
+        for (int c = 0; c < 3; c++) {
+            float unit = extent[c] > 0.0f
+                ? (values[k][c] - low[c]) / extent[c] : 0.0f;
+            m_vectorData.push_back(static_cast<uint16_t>(
+                std::lround(glm::clamp(unit, 0.0f, 1.0f) * 65535.0f)));
+        }
+    }
+    tracks.push_back(track);
+}
+
+void AnimationClip::sample(float time, LocalPose& pose) const {
+    float frame = wrapTime(time, m_duration) * m_sampleRate;
+    uint32_t f0 = std::min(static_cast<uint32_t>(frame), m_frameCount - 1);
+    uint32_t f1 = std::min(f0 + 1, m_frameCount - 1);
+    float alpha = glm::clamp(frame - f0, 0.0f, 1.0f);
+    size_t jointCount = m_rotations.size();
+
+#ifdef VENGINE_SSE
+    __m128 t = _mm_set1_ps(alpha);
+    __m128 rotationScale = _mm_set1_ps(1.0f / 32767.0f);
+
+    for (size_t j = 0; j < jointCount; j++) {
+        const Track& rotation = m_rotations[j];
+        uint32_t k0 = rotation.keyCount > 1 ? f0 : 0;
+        uint32_t k1 = rotation.keyCount > 1 ? f1 : 0;
+        const int16_t* r = &m_rotationData[rotation.offset];
+        __m128 r0 = loadRotation(r + k0 * 4);
+        __m128 r1 = loadRotation(r + k1 * 4);
+        __m128 q = _mm_add_ps(r0, _mm_mul_ps(_mm_sub_ps(r1, r0), t));
+        _mm_storeu_ps(&pose.rotations[j].x, _mm_mul_ps(q, rotationScale));
+
+        const RangeTrack* tracks[2] = {
+            &m_translations[j], &m_scales[j] };
+        glm::vec4* outputs[2] = {
+            &pose.translations[j], &pose.scales[j] };
+        for (int i = 0; i < 2; i++) {
+            const RangeTrack& track = *tracks[i];
+            k0 = track.keyCount > 1 ? f0 : 0;
+            k1 = track.keyCount > 1 ? f1 : 0;
+            const uint16_t* v = &m_vectorData[track.offset];
+            __m128 v0 = loadVector(v + k0 * 3);
+            __m128 v1 = loadVector(v + k1 * 3);
+            __m128 u = _mm_add_ps(v0, _mm_mul_ps(_mm_sub_ps(v1, v0), t));
+            __m128 value = _mm_add_ps(_mm_loadu_ps(&track.min.x),
+                _mm_mul_ps(u, _mm_loadu_ps(&track.scale.x)));
+            _mm_storeu_ps(&outputs[i]->x, value);
+        }
+    }
+#else
+    for (size_t j = 0; j < jointCount; j++) {
+        const Track& rotation = m_rotations[j];
+        uint32_t k0 = rotation.keyCount > 1 ? f0 : 0;
+        uint32_t k1 = rotation.keyCount > 1 ? f1 : 0;
+        const int16_t* r = &m_rotationData[rotation.offset];
+        for (int c = 0; c < 4; c++) {
+            float a = r[k0 * 4 + c], b = r[k1 * 4 + c];
+            pose.rotations[j][c] = (a + (b - a) * alpha) / 32767.0f;
+        }
+
+        const RangeTrack* tracks[2] = {
+            &m_translations[j], &m_scales[j] };
+        glm::vec4* outputs[2] = {
+            &pose.translations[j], &pose.scales[j] };
+        for (int i = 0; i < 2; i++) {
+            const RangeTrack& track = *tracks[i];
+            k0 = track.keyCount > 1 ? f0 : 0;
+            k1 = track.keyCount > 1 ? f1 : 0;
+            const uint16_t* v = &m_vectorData[track.offset];
+            for (int c = 0; c < 3; c++) {
+                float a = v[k0 * 3 + c], b = v[k1 * 3 + c];
+                (*outputs[i])[c] = track.min[c]
+                    + (a + (b - a) * alpha) * track.scale[c];
+            }
+            (*outputs[i]).w = 0.0f;
+        }
+    }
+#endif
+}
+
+size_t AnimationClip::getMemorySize() const {
+    return m_rotationData.size() * sizeof(int16_t)
+        + m_vectorData.size() * sizeof(uint16_t)
+        + m_rotations.size() * sizeof(Track)
+        + (m_translations.size() + m_scales.size()) * sizeof(RangeTrack);
+}
+
+void blendPoses(const LocalPose& a, const LocalPose& b, float weight,
+    LocalPose& result) {
+    size_t jointCount = a.size();
+
+#ifdef VENGINE_SSE
+    __m128 t = _mm_set1_ps(weight);
+    for (size_t j = 0; j < jointCount; j++) {
+        __m128 ta = _mm_loadu_ps(&a.translations[j].x);
+        __m128 tb = _mm_loadu_ps(&b.translations[j].x);
+        _mm_storeu_ps(&result.translations[j].x,
+            _mm_add_ps(ta, _mm_mul_ps(_mm_sub_ps(tb, ta), t)));
+
+        __m128 sa = _mm_loadu_ps(&a.scales[j].x);
+        __m128 sb = _mm_loadu_ps(&b.scales[j].x);
+        _mm_storeu_ps(&result.scales[j].x,
+            _mm_add_ps(sa, _mm_mul_ps(_mm_sub_ps(sb, sa), t)));
+
+        // Short arc: flip b when the quaternions point apart
+        float sign = glm::dot(a.rotations[j], b.rotations[j]) < 0.0f
+            ? -1.0f : 1.0f;
+        __m128 ra = _mm_loadu_ps(&a.rotations[j].x);
+        __m128 rb = _mm_mul_ps(_mm_loadu_ps(&b.rotations[j].x),
+            _mm_set1_ps(sign));
+        _mm_storeu_ps(&result.rotations[j].x,
+            _mm_add_ps(ra, _mm_mul_ps(_mm_sub_ps(rb, ra), t)));
+    }
+#else
+    for (size_t j = 0; j < jointCount; j++) {
+        result.translations[j] = a.translations[j]
+            + (b.translations[j] - a.translations[j]) * weight;
+        result.scales[j] = a.scales[j] + (b.scales[j] - a.scales[j]) * weight;
+        glm::vec4 target = glm::dot(a.rotations[j], b.rotations[j]) < 0.0f
+            ? -b.rotations[j] : b.rotations[j];
+        result.rotations[j] = a.rotations[j]
+            + (target - a.rotations[j]) * weight;
+    }
+#endif
+}
+
+int Animator::addInstance(const Skeleton& skeleton) {
+    Instance instance;
+    instance.skeleton = &skeleton;
+    instance.paletteOffset = static_cast<uint32_t>(m_palettes.size());
+    m_palettes.resize(m_palettes.size() + skeleton.boneJoints.size(),
+        glm::mat4(1.0f));
+    m_instances.push_back(instance);
+
+    // One workspace per job chunk, sized for the largest skeleton, so
+    // update() never allocates
+    m_maxJoints = std::max(m_maxJoints, skeleton.getJointCount());
+    m_workspaces.resize((m_instances.size() + INSTANCE_GRAIN - 1)
+        / INSTANCE_GRAIN);
+    for (auto& workspace : m_workspaces) {
+        workspace.pose.resize(m_maxJoints);
+        workspace.blendPose.resize(m_maxJoints);
+        workspace.globals.resize(m_maxJoints);
+    }
+    return static_cast<int>(m_instances.size() - 1);
+}
+
+void Animator::clear() {
+    m_instances.clear();
+    m_palettes.clear();
+    m_workspaces.clear();
+    m_maxJoints = 0;
+}
+
+void Animator::update(float deltaTime, JobSystem* jobs) {
+    // parallelFor splits at multiples of the grain from 0
+    auto body = [&](size_t begin, size_t end) {
+        Workspace& workspace = m_workspaces[begin / INSTANCE_GRAIN];
+        for (size_t i = begin; i < end; i++) {
+            updateInstance(m_instances[i], deltaTime, workspace);
+        }
+    };
+    if (jobs)
+        jobs->parallelFor(0, m_instances.size(), INSTANCE_GRAIN, body);
+    else
+        body(0, m_instances.size());
+}
+
+void Animator::updateInstance(Instance& instance, float deltaTime,
+    Workspace& workspace) {
+    const Skeleton& skeleton = *instance.skeleton;
+    AnimationState& state = instance.state;
+    size_t jointCount = skeleton.getJointCount();
+
+    const LocalPose* local = &skeleton.bindPose;
+    if (state.clip && state.clip->getJointCount() == jointCount) {
+        state.time = wrapTime(state.time + deltaTime * state.speed,
+            state.clip->getDuration());
+        workspace.pose.resize(jointCount);
+        state.clip->sample(state.time, workspace.pose);
+
+        const AnimationClip* blendClip = state.blendClip;
+        if (blendClip && blendClip->getJointCount() == jointCount) {
+            state.blendTime = wrapTime(
+                state.blendTime + deltaTime * state.speed,
+                blendClip->getDuration());
+            if (state.blendWeight > 0.0f) {
+                workspace.blendPose.resize(jointCount);
+                blendClip->sample(state.blendTime, workspace.blendPose);
+                blendPoses(workspace.pose, workspace.blendPose,
+                    state.blendWeight, workspace.pose);
+            }
+        }
+        local = &workspace.pose;
+    }
+
+    // Parents first, so each global is complete before its children
+    std::vector<glm::mat4>& globals = workspace.globals;
+    globals.resize(jointCount);
+    for (size_t j = 0; j < jointCount; j++) {
+        composeMatrix(local->translations[j], local->rotations[j],
+            local->scales[j], globals[j]);
+        int parent = skeleton.parents[j];
+        multiply(parent < 0 ? skeleton.rootTransform : globals[parent],
+            globals[j], globals[j]);
+    }
+
+    glm::mat4* palette = &m_palettes[instance.paletteOffset];
+    for (size_t b = 0; b < skeleton.boneJoints.size(); b++) {
+        multiply(globals[skeleton.boneJoints[b]], skeleton.boneOffsets[b],
+            palette[b]);
+    }
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+// Size of the bone array in skinned.vert; vertex bone ids are 8-bit
+const uint32_t MAX_BONES = 128;
+
+// Local transforms of every joint; rotations are quaternions (xyzw).
+// vec4 lanes so that sampling and blending run four floats at a time.
+struct LocalPose {
+    std::vector<glm::vec4> translations;   // w unused
+    std::vector<glm::vec4> rotations;
+    std::vector<glm::vec4> scales;         // w unused
+
+    void resize(size_t jointCount);
+    size_t size() const { return rotations.size(); }
+};
+
+// Joint hierarchy; a parent always comes before its children
+struct Skeleton {
+    std::vector<std::string> jointNames;
+    std::vector<int> parents;              // -1 for roots
+    LocalPose bindPose;
+    // Applied above the roots (inverse of the scene root transform)
+    glm::mat4 rootTransform = glm::mat4(1.0f);
+
+    // Skinning palette: vertex bone ids index these two arrays
+    std::vector<uint32_t> boneJoints;
+    std::vector<glm::mat4> boneOffsets;    // mesh space -> bone space
+
+    size_t getJointCount() const { return parents.size(); }
+    int findJoint(const std::string& name) const;
+};
+
+// Uncompressed keys of one joint, times in seconds.
+// Joints without keys keep their bind pose.
+struct JointKeys {
+    std::vector<float> translationTimes;
+    std::vector<glm::vec3> translations;
+    std::vector<float> rotationTimes;
+    std::vector<glm::vec4> rotations;      // xyzw
+    std::vector<float> scaleTimes;
+    std::vector<glm::vec3> scales;
+};
+
+// Keyframes resampled at a fixed rate and quantized: rotations as four
+// int16 per key, translations and scales as three uint16 inside the
+// range of their track. Constant tracks keep a single key.
+class AnimationClip {
+public:
+    std::string name;
+
+    // keys has one entry per skeleton joint (or is shorter)
+    static AnimationClip build(const std::string& name, float duration,
+        const Skeleton& skeleton, const std::vector<JointKeys>& keys,
+        float sampleRate = 30.0f);
+
+    // time wraps around the duration; pose must have the joint count
+    void sample(float time, LocalPose& pose) const;
+
+    float getDuration() const { return m_duration; }
+    size_t getJointCount() const { return m_rotations.size(); }
+    // Bytes of key data, for comparing against raw float keys
+    size_t getMemorySize() const;
+
+private:
+    struct Track {
+        uint32_t offset;          // first component in the data array
+        uint32_t keyCount;        // 1 = constant
+    };
+    struct RangeTrack {
+        uint32_t offset;
+        uint32_t keyCount;
+        glm::vec4 min;            // w = 0
+        glm::vec4 scale;          // extent / 65535, w = 0
+    };
+
+    float m_duration = 0.0f;
+    float m_sampleRate = 30.0f;
+    uint32_t m_frameCount = 1;
+
+    std::vector<Track> m_rotations;
+    std::vector<RangeTrack> m_translations;
+    std::vector<RangeTrack> m_scales;
+    std::vector<int16_t> m_rotationData;
+    // Ends with a spare component, so every key is one 64-bit load
+    std::vector<uint16_t> m_vectorData;
+
+    void addRangeTrack(const std::vector<glm::vec3>& values,
+        std::vector<RangeTrack>& tracks);
+};
+
+// result = lerp(a, b, weight), rotations nlerped along the short arc
+void blendPoses(const LocalPose& a, const LocalPose& b, float weight,
+    LocalPose& result);
+
+// Playback of one clip, optionally cross-faded into a second one
+struct AnimationState {
+    const AnimationClip* clip = nullptr;     // nullptr = bind pose
+    float time = 0.0f;
+    const AnimationClip* blendClip = nullptr;
+    float blendTime = 0.0f;
+    float blendWeight = 0.0f;                // 0 = clip only
+    float speed = 1.0f;
+};
+
+// Animates every instance in one batch: advances time, samples and
+// blends poses and builds the skinning palettes, split across jobs
+class Animator {
+public:
+    // The skeleton and clips must outlive the animator
+    int addInstance(const Skeleton& skeleton);
+    void clear();
+
+    AnimationState& getState(int instance) {
+        return m_instances[instance].state;
+    }
+    size_t getInstanceCount() const { return m_instances.size(); }
+
+    void update(float deltaTime, JobSystem* jobs = nullptr);
+
+    // Skinning matrices of an instance, one per skeleton bone
+    const glm::mat4* getSkinMatrices(int instance) const {
+        return &m_palettes[m_instances[instance].paletteOffset];
+    }
+    uint32_t getBoneCount(int instance) const {
+        return static_cast<uint32_t>(
+            m_instances[instance].skeleton->boneJoints.size());
+    }
+
+private:
+    struct Instance {
+        const Skeleton* skeleton;
+        AnimationState state;
+        uint32_t paletteOffset;
+    };
+    // Per job chunk scratch, kept between frames
+    struct Workspace {
+        LocalPose pose;
+        LocalPose blendPose;
+        std::vector<glm::mat4> globals;
+    };
+
+    std::vector<Instance> m_instances;
+    std::vector<glm::mat4> m_palettes;
+    std::vector<Workspace> m_workspaces;
+    size_t m_maxJoints = 0;
+
+    void updateInstance(Instance& instance, float deltaTime,
+        Workspace& workspace);
+};
@@ -0,0 +1,275 @@
+#include "AssetDatabase.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <iostream>
+#include <unordered_set>
+
+namespace {
+    // Workers of the loader's own job system; they sleep between reloads
+    const int LOADER_WORKERS = 2;
+
+    double elapsedMs(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+AssetDatabase::AssetDatabase()
+    : m_loader(&AssetDatabase::loaderLoop, this) {
+}
+
+AssetDatabase::~AssetDatabase() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeUp.notify_one();
+    m_loader.join();
+}
+
+void AssetDatabase::addShader(Shader& shader, Callback onReload) {
+    Asset asset;
+    asset.type = AssetType::Shader;
+    asset.shader = &shader;
+    asset.onReload = onReload;
+    m_assets.push_back(asset);
+    track(m_assets.size() - 1, shader.getSources());
+}
+
+void AssetDatabase::addModel(Model& model, Callback onReload) {
+    Asset asset;
+    asset.type = AssetType::Model;
+    asset.model = &model;
+    asset.onReload = onReload;
+    m_assets.push_back(asset);
+
+    std::vector<std::string> files = model.getSourceFiles();
+    files.push_back(model.getPath());
+    track(m_assets.size() - 1, files);
+    trackTextures(model);
+}
+
+void AssetDatabase::track(size_t asset,
+    const std::vector<std::string>& files) {
+    std::vector<std::string> previous;
+    previous.swap(m_assets[asset].files);
+    for (const auto& file : previous) {
+        auto& dependents = m_dependents[file];
+        dependents.erase(std::remove(dependents.begin(), dependents.end(),
+            asset), dependents.end());
+    }
+
+    std::vector<std::string> normalized;
+    for (const auto& file : files) {
+        std::string path = FileWatcher::normalize(file);
+        if (std::find(normalized.begin(), normalized.end(), path)
+            != normalized.end()) continue;
+        normalized.push_back(path);
+        m_dependents[path].push_back(asset);
+        m_watcher.watch(path);
+    }
+    m_assets[asset].files = normalized;
+
+    // Files no asset is built from any more stop being watched
+    for (const auto& file : previous) {
+        auto it = m_dependents.find(file);
+        if (it == m_dependents.end() || !it->second.empty()) continue;
+        m_dependents.erase(it);
+        m_watcher.unwatch(file);
+    }
+}
+
+void AssetDatabase::trackTextures(const Model& model) {
+    // One texture asset per image, shared by every model using it
+    for (const auto& path : model.getTexturePaths()) {
+        if (m_textures.count(path)) continue;
+
+        // A texture dropped by an earlier reimport gets its slot back
+        size_t index = m_assets.size();
+        for (size_t i = 0; i < m_assets.size(); i++) {
+            if (m_assets[i].type == AssetType::Texture
+                && m_assets[i].path == path) index = i;
+        }
+        if (index == m_assets.size()) {
+            Asset asset;
+            asset.type = AssetType::Texture;
+            asset.path = path;
+            m_assets.push_back(asset);
+        }
+        m_textures[path] = index;
+        track(index, { path });
+    }
+}
+
+void AssetDatabase::untrackTextures() {
+    std::unordered_set<std::string> used;
+    for (const auto& asset : m_assets) {
+        if (asset.type != AssetType::Model) continue;
+        for (const auto& path : asset.model->getTexturePaths())
+            used.insert(path);
+    }
+
+    // The slot stays (indices are kept by pending loads) without files
+    for (auto it = m_textures.begin(); it != m_textures.end();) {
+        if (used.count(it->first)) {
+            ++it;
+            continue;
+        }
+        m_assets[it->second].dirty = false;
+        track(it->second, {});
+        it = m_textures.erase(it);
+    }
+}
+
+size_t AssetDatabase::update() {
+    size_t swapped = 0;
+
+    // Each affected asset once, however many of its files changed.
+    // Empty vectors do not allocate, so idle frames stay off the heap.
+    std::vector<size_t> changed;
+    for (const auto& file : m_watcher.poll()) {
+        auto it = m_dependents.find(file);
+        if (it == m_dependents.end()) continue;
+        changed.insert(changed.end(), it->second.begin(), it->second.end());
+    }
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()),
+        changed.end());
+
+    for (size_t index : changed) {
+        Asset& asset = m_assets[index];
+        if (asset.type != AssetType::Shader) {
+            schedule(index);
+            continue;
+        }
+
+        // Compiling needs the GL context, so shaders reload right here
+        auto start = std::chrono::steady_clock::now();
+        if (asset.shader->reload()) {
+            std::cout << "Reloaded shader " << asset.files.front()
+                << " (" << elapsedMs(start) << " ms)" << std::endl;
+            if (asset.onReload) asset.onReload();
+            swapped++;
+        }
+    }
+
+    std::vector<Result> results;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        results.swap(m_results);
+    }
+    for (auto& result : results) {
+        size_t index = result.asset;
+        apply(result);
+        swapped++;
+
+        if (m_assets[index].dirty) {
+            m_assets[index].dirty = false;
+            schedule(index);
+        }
+    }
+    return swapped;
+}
+
+void AssetDatabase::schedule(size_t asset) {
+    Asset& entry = m_assets[asset];
+    if (entry.loading) {
+        entry.dirty = true;
+        return;
+    }
+    entry.loading = true;
+    entry.started = std::chrono::steady_clock::now();
+
+    Request request;
+    request.asset = asset;
+    request.type = entry.type;
+    if (entry.type == AssetType::Model) {
+        // Unchanged textures are neither decoded nor uploaded again
+        request.path = entry.model->getPath();
+        for (const auto& path : entry.model->getTexturePaths()) {
+            request.knownImages.insert(path);
+        }
+    }
+    else {
+        request.path = entry.path;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_requests.push_back(std::move(request));
+    }
+    m_wakeUp.notify_one();
+}
+
+void AssetDatabase::apply(Result& result) {
+    size_t index = result.asset;
+    m_assets[index].loading = false;
+    bool success = false;
+
+    // A texture dropped while it was loading has nothing to update
+    if (m_assets[index].type == AssetType::Texture
+        && !m_textures.count(m_assets[index].path)) return;
+
+    if (m_assets[index].type == AssetType::Model) {
+        Model& model = *m_assets[index].model;
+        success = model.reload(std::move(result.model));
+        if (success) {
+            std::vector<std::string> files = model.getSourceFiles();
+            files.push_back(model.getPath());
+            track(index, files);
+            trackTextures(model);
+            untrackTextures();
+        }
+    }
+    else {
+        for (const auto& asset : m_assets) {
+            if (asset.type == AssetType::Model)
+                success |= asset.model->reloadTexture(result.image);
+        }
+    }
+
+    // Failed imports (often a file caught mid-save) keep the old data
+    const Asset& asset = m_assets[index];
+    const std::string& name = asset.files.empty() ? asset.path
+        : asset.files.front();
+    if (success) {
+        std::cout << "Reloaded " << name << " ("
+            << elapsedMs(asset.started) << " ms)" << std::endl;
+        if (asset.onReload) asset.onReload();
+    }
+    else {
+        std::cerr << "Reload failed, keeping " << name << std::endl;
+    }
+}
+
+void AssetDatabase::loaderLoop() {
+    // The loader's own job system: a long import never runs inside a
+    // frame's wait() on the main one
+    JobSystem jobs(LOADER_WORKERS);
+
+    while (true) {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeUp.wait(lock, [this] {
+                return m_stop || !m_requests.empty();
+            });
+            if (m_stop) return;
+            request = std::move(m_requests.front());
+            m_requests.pop_front();
+        }
+
+        Result result;
+        result.asset = request.asset;
+        if (request.type == AssetType::Model) {
+            result.model = Model::import(request.path, &jobs,
+                &request.knownImages);
+        }
+        else {
+            result.image = Model::loadImage(request.path);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_results.push_back(std::move(result));
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "FileWatcher.h"
+#include "Model.h"
+#include "Shader.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Hot reload of registered shaders, models and their textures. Every
+// asset lists the files it was built from (a shader its sources, a model
+// the files Assimp read, a texture its image); a changed file reloads
+// only the assets depending on it. Models and images are imported on a
+// loader thread; update() swaps the results in on the GL thread between
+// frames, so a frame never sees a half-loaded asset. Untouched assets,
+// including the unchanged textures of a reloaded model, keep their GL
+// objects; textures no model references any more stop being watched.
+class AssetDatabase {
+public:
+    using Callback = std::function<void()>;
+
+    AssetDatabase();
+    ~AssetDatabase();
+
+    AssetDatabase(const AssetDatabase&) = delete;
+    AssetDatabase& operator=(const AssetDatabase&) = delete;
+
+    // Assets must outlive the database. onReload runs on the GL thread
+    // after the swap (to refresh caches built from the asset).
+    void addShader(Shader& shader, Callback onReload = nullptr);
+    void addModel(Model& model, Callback onReload = nullptr);
+
+    // Starts reloads for changed files and applies finished ones.
+    // Call once per frame on the GL thread; returns the assets swapped.
+    size_t update();
+
+private:
+    enum class AssetType { Shader, Model, Texture };
+
+    struct Asset {
+        AssetType type;
+        Shader* shader = nullptr;
+        Model* model = nullptr;
+        std::string path;          // texture: key in Model textures
+        Callback onReload;
+        std::vector<std::string> files;
+        bool loading = false;
+        bool dirty = false;        // changed again while loading
+        std::chrono::steady_clock::time_point started;
+    };
+
+    // Loader thread input and output
+    struct Request {
+        size_t asset;
+        AssetType type;
+        std::string path;
+        std::unordered_set<std::string> knownImages;
+    };
+    struct Result {
+        size_t asset;
+        ModelData model;
+        ImageData image;
+    };
+
+    std::vector<Asset> m_assets;
+    // Normalized file -> assets built from it
+    std::unordered_map<std::string, std::vector<size_t>> m_dependents;
+    std::unordered_map<std::string, size_t> m_textures;
+    FileWatcher m_watcher;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::deque<Request> m_requests;
+    std::vector<Result> m_results;
+    bool m_stop = false;
+    std::thread m_loader;
+
+    void track(size_t asset, const std::vector<std::string>& files);
+    void trackTextures(const Model& model);
+    void untrackTextures();
+    void schedule(size_t asset);
+    void apply(Result& result);
+    void loaderLoop();
+};
@@ -0,0 +1,520 @@
+#include "Benchmark.h"
+#include "Animation.h"
+#include "Bvh.h"
+#include "Camera.h"
+#include "FrameArena.h"
+#include "JobSystem.h"
+#include "Meshlet.h"
+#include "World.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    double elapsedMs(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(
+            Clock::now() - start).count();
+    }
+
+    // Exact-result checks under contention: tiny jobs, dependency
+    // chains and parallelFor nested inside jobs
+    bool stressJobs(JobSystem& jobs) {
+        for (int iteration = 0; iteration < 50; iteration++) {
+            std::atomic<long long> sum{ 0 };
+            jobs.parallelFor(0, 100000, 7, [&](size_t begin, size_t end) {
+                long long local = 0;
+                for (size_t i = begin; i < end; i++) local += i;
+                sum += local;
+            });
+            if (sum != 4999950000LL) return false;
+
+            struct Stage {
+                std::atomic<int> done{ 0 };
+                std::atomic<int> early{ 0 };
+            } stage;
+            JobCounter first, second;
+            for (int i = 0; i < 100; i++) {
+                jobs.run([](void* data, size_t, size_t) {
+                    static_cast<Stage*>(data)->done++;
+                }, &stage, 0, 0, &first);
+            }
+            for (int i = 0; i < 100; i++) {
+                jobs.run([](void* data, size_t, size_t) {
+                    Stage* s = static_cast<Stage*>(data);
+                    if (s->done < 100) s->early++;
+                }, &stage, 0, 0, &second, &first);
+            }
+            jobs.wait(second);
+            if (stage.early != 0) return false;
+
+            std::atomic<long long> nested{ 0 };
+            jobs.parallelFor(0, 32, 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    jobs.parallelFor(0, 1000, 16, [&](size_t b, size_t e) {
+                        nested += e - b;
+                    });
+                }
+            });
+            if (nested != 32000) return false;
+        }
+        return true;
+    }
+
+    // Transform update, culling and sort-key generation of a large
+    // world, from 1 thread up to every hardware thread
+    int benchJobs() {
+        const size_t ENTITY_COUNT = 200000;
+        const int FRAMES = 30;
+
+        // No meshes, so no GL context is needed
+        Model model{ ModelData() };
+        World world;
+        uint32_t handle = world.addModel(model);
+
+        uint32_t seed = 12345;
+        auto random = [&seed]() {
+            seed = seed * 1664525u + 1013904223u;
+            return (seed >> 8) / float(1 << 24);
+        };
+        for (size_t i = 0; i < ENTITY_COUNT; i++) {
+            Entity e = world.createEntity(handle);
+            world.setPosition(e, glm::vec3(random() * 400.0f - 200.0f,
+                random() * 20.0f, random() * 400.0f - 200.0f));
+            world.setRotation(e, glm::vec3(0.0f, random() * 360.0f, 0.0f));
+        }
+
+        Camera camera;
+        Frustum frustum = Frustum::fromMatrix(
+            camera.getProjectionMatrix(16.0f / 9.0f)
+            * camera.getViewMatrix());
+        FrameArena arena(8 << 20);
+
+        unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        double baseline = 0.0;
+        size_t expectedVisible = 0;
+        bool ok = true;
+
+        std::cout << "Job system scaling: " << ENTITY_COUNT
+            << " entities, " << FRAMES << " frames" << std::endl;
+        std::cout << "threads   ms/frame   speedup   stress" << std::endl;
+
+        for (unsigned threads = 1; threads <= maxThreads; threads++) {
+            JobSystem jobs(static_cast<int>(threads) - 1);
+            bool stress = stressJobs(jobs);
+
+            size_t visible = 0;
+            Clock::time_point start = Clock::now();
+            for (int frame = 0; frame < FRAMES; frame++) {
+                arena.reset();
+                world.updateTransforms(&jobs);
+                auto visibleSet = world.cull(frustum, arena, &jobs);
+                auto drawList = world.buildDrawList(visibleSet,
+                    camera.position, arena, &jobs);
+                visible = drawList.size;
+            }
+            double ms = elapsedMs(start) / FRAMES;
+
+            if (threads == 1) {
+                baseline = ms;
+                expectedVisible = visible;
+            }
+            ok = ok && stress && visible == expectedVisible;
+
+            std::cout << std::setw(7) << threads
+                << std::setw(11) << std::fixed << std::setprecision(3) << ms
+                << std::setw(10) << std::setprecision(2) << baseline / ms
+                << std::setw(9) << (stress ? "ok" : "FAILED") << std::endl;
+        }
+
+        return ok ? 0 : 1;
+    }
+
+    // Closest hit over every mesh of a model, -1 on a miss
+    float castRay(const ModelData& model, const Ray& ray, bool bruteForce) {
+        float closest = std::numeric_limits<float>::max();
+        bool found = false;
+        for (const auto& mesh : model.meshes) {
+            TriangleHit hit;
+            bool hitMesh = bruteForce
+                ? mesh.bvh.raycastBruteForce(ray, closest, hit)
+                : mesh.bvh.raycast(ray, closest, hit);
+            if (hitMesh) {
+                closest = hit.t;
+                found = true;
+            }
+        }
+        return found ? closest : -1.0f;
+    }
+
+    // Rays from a surrounding sphere into the bounds of each car model,
+    // single-threaded and across the job system
+    int benchBvh() {
+        const char* MODELS[] = {
+            "assets/models/LamboDiablo.fbx",
+            "assets/models/Nissan_180SX.fbx",
+            "assets/models/Opel_Astra_H.fbx"
+        };
+        const size_t RAY_COUNT = 1 << 20;
+        const size_t CHECK_COUNT = 1000;     // compared with brute force
+        const size_t RAY_GRAIN = 4096;
+
+        JobSystem jobs;
+        bool ok = true;
+
+        std::cout << "BVH ray casts: " << RAY_COUNT << " rays per model, "
+            << jobs.getThreadCount() << " threads" << std::endl;
+        std::cout << "model                 triangles  build ms"
+            "  Mrays/s 1T  Mrays/s MT  hit %  check" << std::endl;
+
+        for (const char* path : MODELS) {
+            ModelData model = Model::import(path, &jobs);
+            if (model.meshes.empty()) {
+                std::cerr << "Failed to load " << path << std::endl;
+                ok = false;
+                continue;
+            }
+
+            // Rebuilt serially here so the build time is measurable
+            size_t triangles = 0;
+            glm::vec3 boundsMin(std::numeric_limits<float>::max());
+            glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+            Clock::time_point start = Clock::now();
+            for (auto& mesh : model.meshes) {
+                mesh.bvh.build(mesh.vertices, mesh.indices);
+                triangles += mesh.bvh.getTriangleCount();
+                for (const auto& vertex : mesh.vertices) {
+                    boundsMin = glm::min(boundsMin, vertex.position);
+                    boundsMax = glm::max(boundsMax, vertex.position);
+                }
+            }
+            double buildMs = elapsedMs(start);
+
+            glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+            float radius = glm::length(boundsMax - boundsMin);
+            std::mt19937 random(7);
+            std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+            std::normal_distribution<float> normal;
+            std::vector<Ray> rays(RAY_COUNT);
+            for (auto& ray : rays) {
+                glm::vec3 onSphere = glm::normalize(glm::vec3(
+                    normal(random), normal(random), normal(random)));
+                glm::vec3 target = boundsMin + (boundsMax - boundsMin)
+                    * glm::vec3(unit(random), unit(random), unit(random));
+                ray.origin = center + onSphere * radius;
+                ray.direction = glm::normalize(target - ray.origin);
+            }
+
+            std::atomic<size_t> hits{ 0 };
+            auto castRange = [&](size_t begin, size_t end) {
+                size_t local = 0;
+                for (size_t i = begin; i < end; i++) {
+                    local += castRay(model, rays[i], false) >= 0.0f;
+                }
+                hits += local;
+            };
+
+            start = Clock::now();
+            castRange(0, RAY_COUNT);
+            double singleMs = elapsedMs(start);
+
+            hits = 0;
+            start = Clock::now();
+            jobs.parallelFor(0, RAY_COUNT, RAY_GRAIN, castRange);
+            double parallelMs = elapsedMs(start);
+
+            size_t mismatches = 0;
+            for (size_t i = 0; i < CHECK_COUNT; i++) {
+                float t = castRay(model, rays[i], false);
+                float expected = castRay(model, rays[i], true);
+                if (std::fabs(t - expected) > 1e-4f * radius) mismatches++;
+            }
+            ok = ok && mismatches == 0;
+
+            std::string name = path;
+            name = name.substr(name.find_last_of('/') + 1);
+            std::cout << std::left << std::setw(20) << name << std::right
+                << std::setw(11) << triangles
+                << std::setw(10) << std::fixed << std::setprecision(1)
+                << buildMs
+                << std::setw(12) << std::setprecision(2)
+                << RAY_COUNT / singleMs / 1000.0
+                << std::setw(12) << RAY_COUNT / parallelMs / 1000.0
+                << std::setw(7) << std::setprecision(1)
+                << 100.0 * hits / RAY_COUNT
+                << std::setw(7) << (mismatches ? "FAILED" : "ok")
+                << std::endl;
+        }
+
+        return ok ? 0 : 1;
+    }
+
+    // Meshlet statistics of every bundled model, and rejection rates from
+    // cameras orbiting it
+    int benchMeshlets() {
+        const char* MODELS[] = {
+            "assets/models/4AGE.fbx",
+            "assets/models/Cube.fbx",
+            "assets/models/LamboDiablo.fbx",
+            "assets/models/Nissan_180SX.fbx",
+            "assets/models/Opel_Astra_H.fbx"
+        };
+        const int VIEWS = 64;
+
+        JobSystem jobs;
+        Camera camera;
+        bool ok = true;
+
+        std::cout << "Meshlet culling: " << VIEWS << " orbiting views"
+            << std::endl;
+        std::cout << "model                 meshlets  verts  tris"
+            "  frustum %  back-facing %  triangles %  us/view" << std::endl;
+
+        for (const char* path : MODELS) {
+            ModelData model = Model::import(path, &jobs);
+            if (model.meshes.empty()) {
+                std::cerr << "Failed to load " << path << std::endl;
+                ok = false;
+                continue;
+            }
+
+            size_t meshletCount = 0, vertexCount = 0, triangleCount = 0;
+            size_t maxMeshlets = 0;
+            glm::vec3 boundsMin(std::numeric_limits<float>::max());
+            glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+            for (const auto& mesh : model.meshes) {
+                for (const auto& meshlet : mesh.meshlets) {
+                    vertexCount += meshlet.vertexCount;
+                    triangleCount += meshlet.triangleCount;
+                    ok = ok && meshlet.vertexCount <= MESHLET_MAX_VERTICES
+                        && meshlet.triangleCount <= MESHLET_MAX_TRIANGLES;
+                }
+                meshletCount += mesh.meshlets.size();
+                maxMeshlets = std::max(maxMeshlets, mesh.meshlets.size());
+                for (const auto& vertex : mesh.vertices) {
+                    boundsMin = glm::min(boundsMin, vertex.position);
+                    boundsMax = glm::max(boundsMax, vertex.position);
+                }
+            }
+
+            // Cameras on a tilted ring, some with the model partly off-screen
+            glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+            float radius = glm::length(boundsMax - boundsMin) * 0.5f;
+            std::vector<GLsizei> counts(maxMeshlets);
+            std::vector<const void*> offsets(maxMeshlets);
+            ClusterStats stats;
+
+            Clock::time_point start = Clock::now();
+            for (int view = 0; view < VIEWS; view++) {
+                float angle = 6.2831853f * view / VIEWS;
+                glm::vec3 eye = center + radius * 2.0f * glm::vec3(
+                    std::cos(angle), 0.5f * std::sin(angle * 3.0f),
+                    std::sin(angle));
+                glm::vec3 target = center + (view % 4 == 0
+                    ? glm::vec3(radius, 0.0f, 0.0f) : glm::vec3(0.0f));
+                Frustum frustum = Frustum::fromMatrix(
+                    camera.getProjectionMatrix(16.0f / 9.0f)
+                    * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f)));
+
+                for (const auto& mesh : model.meshes) {
+                    cullMeshlets(mesh.meshlets, frustum, eye,
+                        counts.data(), offsets.data(), stats);
+                }
+            }
+            double usPerView = elapsedMs(start) * 1000.0 / VIEWS;
+
+            std::string name = path;
+            name = name.substr(name.find_last_of('/') + 1);
+            double clusters = std::max<double>(1.0, (double)stats.clusters);
+            std::cout << std::left << std::setw(20) << name << std::right
+                << std::setw(11) << meshletCount
+                << std::setw(7) << std::fixed << std::setprecision(1)
+                << (double)vertexCount / std::max<size_t>(meshletCount, 1)
+                << std::setw(6)
+                << (double)triangleCount / std::max<size_t>(meshletCount, 1)
+                << std::setw(11) << 100.0 * stats.frustumCulled / clusters
+                << std::setw(15) << 100.0 * stats.backfaceCulled / clusters
+                << std::setw(13) << 100.0 * stats.trianglesCulled
+                / std::max<double>(1.0, (double)stats.triangles)
+                << std::setw(9) << std::setprecision(2) << usPerView
+                << std::endl;
+        }
+
+        return ok ? 0 : 1;
+    }
+
+    // Swinging joint: rotation about z, as an xyzw quaternion
+    glm::vec4 swing(float angle) {
+        return glm::vec4(0.0f, 0.0f, std::sin(angle * 0.5f),
+            std::cos(angle * 0.5f));
+    }
+
+    // No bundled asset is animated, so the rig is synthetic: a binary
+    // tree of joints and two looping clips that every instance blends
+    int benchAnimation() {
+        const int JOINT_COUNT = 64;
+        const int INSTANCE_COUNT = 10000;
+        const int FRAMES = 30;
+        const float KEY_RATE = 30.0f;
+        const float DURATIONS[] = { 1.0f, 0.6f };
+
+        Skeleton skeleton;
+        std::vector<glm::vec3> bindPositions(JOINT_COUNT);
+        skeleton.bindPose.resize(JOINT_COUNT);
+        for (int j = 0; j < JOINT_COUNT; j++) {
+            int parent = j > 0 ? (j - 1) / 2 : -1;
+            glm::vec3 offset = j > 0 ? glm::vec3(0.0f, 1.0f, 0.0f)
+                : glm::vec3(0.0f);
+            skeleton.jointNames.push_back("joint" + std::to_string(j));
+            skeleton.parents.push_back(parent);
+            skeleton.bindPose.translations[j] = glm::vec4(offset, 0.0f);
+            skeleton.bindPose.rotations[j] = swing(0.0f);
+            skeleton.bindPose.scales[j] = glm::vec4(1.0f);
+
+            // Bind globals are translations, so their inverse is too
+            bindPositions[j] = offset
+                + (parent >= 0 ? bindPositions[parent] : glm::vec3(0.0f));
+            glm::mat4 toBone(1.0f);
+            toBone[3] = glm::vec4(-bindPositions[j], 1.0f);
+            skeleton.boneJoints.push_back(static_cast<uint32_t>(j));
+            skeleton.boneOffsets.push_back(toBone);
+        }
+
+        // Keys at exactly the clip rate: decoding error is quantization only
+        std::vector<AnimationClip> clips;
+        size_t rawSize = 0, compressedSize = 0;
+        float maxError = 0.0f;
+        for (int c = 0; c < 2; c++) {
+            float duration = DURATIONS[c];
+            int keyCount = static_cast<int>(duration * KEY_RATE) + 1;
+            auto angle = [&](int joint, float time) {
+                return 0.6f * std::sin(6.2831853f * time / duration
+                    + joint * 0.7f + c);
+            };
+
+            std::vector<JointKeys> keys(JOINT_COUNT);
+            for (int j = 0; j < JOINT_COUNT; j++) {
+                for (int k = 0; k < keyCount; k++) {
+                    float time = k / KEY_RATE;
+                    keys[j].rotationTimes.push_back(time);
+                    keys[j].rotations.push_back(swing(angle(j, time)));
+                    if (j == 0) {
+                        keys[j].translationTimes.push_back(time);
+                        keys[j].translations.push_back(
+                            glm::vec3(0.0f, 0.1f * std::sin(angle(0, time)),
+                                time));
+                    }
+                }
+                rawSize += keys[j].rotations.size() * sizeof(float) * 5
+                    + keys[j].translations.size() * sizeof(float) * 4;
+            }
+            clips.push_back(AnimationClip::build(c ? "run" : "walk",
+                duration, skeleton, keys, KEY_RATE));
+            compressedSize += clips.back().getMemorySize();
+
+            LocalPose pose;
+            pose.resize(JOINT_COUNT);
+            for (int k = 0; k + 1 < keyCount; k++) {
+                float time = k / KEY_RATE;
+                clips.back().sample(time, pose);
+                for (int j = 0; j < JOINT_COUNT; j++) {
+                    glm::vec4 d = glm::abs(pose.rotations[j]
+                        - swing(angle(j, time)));
+                    maxError = std::max(maxError, std::max(
+                        std::max(d.x, d.y), std::max(d.z, d.w)));
+                }
+            }
+        }
+
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> random(0.0f, 1.0f);
+        std::vector<AnimationState> initial(INSTANCE_COUNT);
+        for (auto& state : initial) {
+            state.clip = &clips[0];
+            state.time = random(rng) * DURATIONS[0];
+            state.blendClip = &clips[1];
+            state.blendTime = random(rng) * DURATIONS[1];
+            state.blendWeight = random(rng);
+            state.speed = 0.5f + random(rng);
+        }
+
+        Animator animator;
+        for (int i = 0; i < INSTANCE_COUNT; i++) {
+            animator.addInstance(skeleton);
+        }
+
+        unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        double baseline = 0.0, expectedChecksum = 0.0;
+        bool ok = maxError < 1e-3f;
+
+        std::cout << "Animation: " << INSTANCE_COUNT << " instances, "
+            << JOINT_COUNT << " joints, 2 blended clips, " << FRAMES
+            << " frames" << std::endl;
+        std::cout << "clip data: " << rawSize / 1024 << " KB raw -> "
+            << compressedSize / 1024 << " KB, max rotation error "
+            << std::scientific << std::setprecision(2) << maxError
+            << std::endl;
+        std::cout << "threads   ms/frame   instances/ms   speedup"
+            << std::endl;
+
+        for (unsigned threads = 1; threads <= maxThreads; threads++) {
+            JobSystem jobs(static_cast<int>(threads) - 1);
+            for (int i = 0; i < INSTANCE_COUNT; i++) {
+                animator.getState(i) = initial[i];
+            }
+
+            Clock::time_point start = Clock::now();
+            for (int frame = 0; frame < FRAMES; frame++) {
+                animator.update(1.0f / 60.0f, &jobs);
+            }
+            double ms = elapsedMs(start) / FRAMES;
+
+            // Same poses for every thread count
+            double checksum = 0.0;
+            for (int i = 0; i < INSTANCE_COUNT; i += 97) {
+                const glm::mat4* skin = animator.getSkinMatrices(i);
+                for (uint32_t b = 0; b < animator.getBoneCount(i); b++) {
+                    checksum += skin[b][3].x + skin[b][3].y + skin[b][0].x;
+                }
+            }
+            if (threads == 1) {
+                baseline = ms;
+                expectedChecksum = checksum;
+            }
+            ok = ok && checksum == expectedChecksum;
+
+            std::cout << std::setw(7) << threads
+                << std::setw(11) << std::fixed << std::setprecision(3) << ms
+                << std::setw(15) << std::setprecision(1)
+                << INSTANCE_COUNT / ms
+                << std::setw(10) << std::setprecision(2) << baseline / ms
+                << std::endl;
+        }
+
+        return ok ? 0 : 1;
+    }
+}
+
+int runBenchmarks(int argc, char** argv) {
+    std::string name = argc > 2 ? argv[2] : "";
+    int result = 0;
+
+    if (name.empty() || name == "jobs")
+        result |= benchJobs();
+    if (name.empty() || name == "bvh")
+        result |= benchBvh();
+    if (name.empty() || name == "meshlets")
+        result |= benchMeshlets();
+    if (name.empty() || name == "animation")
+        result |= benchAnimation();
+
+    return result;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// Command-line benchmarks: Vengine --bench [name]
+// Runs every suite when no name is given; returns the process exit code.
+int runBenchmarks(int argc, char** argv);
@@ -0,0 +1,49 @@
+#include "BoneBuffer.h"
+#include "Shader.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    // std140 block size; the whole block must be backed by the range
+    const GLsizeiptr PALETTE_SIZE = MAX_BONES * sizeof(glm::mat4);
+}
+
+void BoneBuffer::upload(const Animator& animator) {
+    size_t count = animator.getInstanceCount();
+    GLsizeiptr alignment = StreamBuffer::offsetAlignment(GL_UNIFORM_BUFFER);
+    GLsizeiptr stride = (PALETTE_SIZE + alignment - 1)
+        / alignment * alignment;
+
+    if (count > m_capacity || !m_buffer) {
+        m_capacity = std::max<size_t>(count, 16);
+        m_buffer = std::make_unique<StreamBuffer>(GL_UNIFORM_BUFFER,
+            static_cast<GLsizeiptr>(m_capacity) * stride);
+    }
+
+    m_buffer->beginFrame();
+    m_offsets.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        int instance = static_cast<int>(i);
+        auto alloc = m_buffer->allocate(PALETTE_SIZE, alignment);
+        std::memcpy(alloc.data, animator.getSkinMatrices(instance),
+            animator.getBoneCount(instance) * sizeof(glm::mat4));
+        m_offsets[i] = alloc.offset;
+    }
+    m_buffer->flush();
+}
+
+void BoneBuffer::bind(int instance) const {
+    glBindBufferRange(GL_UNIFORM_BUFFER, BINDING, m_buffer->getID(),
+        m_offsets[instance], PALETTE_SIZE);
+}
+
+void BoneBuffer::endFrame() {
+    if (m_buffer) m_buffer->endFrame();
+}
+
+void BoneBuffer::setupShader(const Shader& shader) {
+    GLuint block = glGetUniformBlockIndex(shader.ID, "Bones");
+    if (block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(shader.ID, block, BINDING);
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "Animation.h"
+#include "StreamBuffer.h"
+#include <glad/glad.h>
+#include <memory>
+#include <vector>
+
+// Skinning palettes of every Animator instance in a per-frame uniform
+// ring; bind() points the Bones block of skinned.vert at one of them
+class BoneBuffer {
+public:
+    static const GLuint BINDING = 0;
+
+    // Call once per frame after Animator::update; grows as needed
+    void upload(const Animator& animator);
+    void bind(int instance) const;
+    // Call after the last skinned draw of the frame
+    void endFrame();
+
+    // Connects the Bones block of a skinned shader to BINDING
+    static void setupShader(const class Shader& shader);
+
+private:
+    std::unique_ptr<StreamBuffer> m_buffer;
+    size_t m_capacity = 0;
+    std::vector<GLintptr> m_offsets;
+};
@@ -0,0 +1,489 @@
+#include "Bvh.h"
+#include "Mesh.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VENGINE_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+    const int BIN_COUNT = 12;
+    // Past this depth splits fall back to the object median, which
+    // bounds the tree depth for the fixed traversal stacks
+    const int MEDIAN_SPLIT_DEPTH = 48;
+    const int STACK_SIZE = 96;
+    const float INF = std::numeric_limits<float>::infinity();
+    // Finite stand-in for 1/0: slab distances never compute 0 * inf
+    const float MAX_INV_DIR = 1e30f;
+
+    float surfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+        glm::vec3 e = boundsMax - boundsMin;
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+
+    struct Bin {
+        glm::vec3 boundsMin = glm::vec3(INF);
+        glm::vec3 boundsMax = glm::vec3(-INF);
+        uint32_t count = 0;
+
+        void grow(const glm::vec3& otherMin, const glm::vec3& otherMax) {
+            boundsMin = glm::min(boundsMin, otherMin);
+            boundsMax = glm::max(boundsMax, otherMax);
+        }
+        float area() const { return surfaceArea(boundsMin, boundsMax); }
+    };
+
+    // Moller-Trumbore, two-sided
+    bool intersectTriangle(const Ray& ray, const glm::vec3* corners,
+        float& t) {
+        glm::vec3 e1 = corners[1] - corners[0];
+        glm::vec3 e2 = corners[2] - corners[0];
+        glm::vec3 p = glm::cross(ray.direction, e2);
+        float det = glm::dot(e1, p);
+        if (std::fabs(det) < 1e-12f) return false;
+
+        float invDet = 1.0f / det;
+        glm::vec3 s = ray.origin - corners[0];
+        float u = glm::dot(s, p) * invDet;
+        if (u < 0.0f || u > 1.0f) return false;
+
+        glm::vec3 q = glm::cross(s, e1);
+        float v = glm::dot(ray.direction, q) * invDet;
+        if (v < 0.0f || u + v > 1.0f) return false;
+
+        t = glm::dot(e2, q) * invDet;
+        return t >= 0.0f;
+    }
+
+    glm::vec3 transformPoint(const glm::mat4& m, const glm::vec3& p) {
+        return glm::vec3(m * glm::vec4(p, 1.0f));
+    }
+}
+
+void buildBvh(const std::vector<glm::vec3>& primMin,
+    const std::vector<glm::vec3>& primMax, uint32_t maxLeafSize,
+    std::vector<BvhNode>& nodes, std::vector<uint32_t>& order) {
+    uint32_t count = static_cast<uint32_t>(primMin.size());
+    nodes.clear();
+    order.resize(count);
+    for (uint32_t i = 0; i < count; i++) order[i] = i;
+    if (count == 0) return;
+
+    std::vector<glm::vec3> centroids(count);
+    for (uint32_t i = 0; i < count; i++) {
+        centroids[i] = (primMin[i] + primMax[i]) * 0.5f;
+    }
+
+    auto updateBounds = [&](BvhNode& node) {
+        node.boundsMin = glm::vec3(INF);
+        node.boundsMax = glm::vec3(-INF);
+        for (uint32_t i = 0; i < node.count; i++) {
+            uint32_t prim = order[node.leftFirst + i];
+            node.boundsMin = glm::min(node.boundsMin, primMin[prim]);
+            node.boundsMax = glm::max(node.boundsMax, primMax[prim]);
+        }
+    };
+
+    // Binary tree with single-primitive leaves at most: 2n - 1 nodes, so
+    // references into `nodes` stay valid during the build
+    nodes.reserve(2 * count - 1);
+    nodes.push_back(BvhNode());
+    nodes[0].leftFirst = 0;
+    nodes[0].count = count;
+    updateBounds(nodes[0]);
+
+    struct Task { uint32_t node; int depth; };
+    std::vector<Task> tasks;
+    tasks.push_back({ 0, 0 });
+
+    while (!tasks.empty()) {
+        Task task = tasks.back();
+        tasks.pop_back();
+        BvhNode& node = nodes[task.node];
+        if (node.count <= maxLeafSize) continue;
+
+        uint32_t first = node.leftFirst;
+        uint32_t last = first + node.count;
+        glm::vec3 centroidMin(INF), centroidMax(-INF);
+        for (uint32_t i = first; i < last; i++) {
+            centroidMin = glm::min(centroidMin, centroids[order[i]]);
+            centroidMax = glm::max(centroidMax, centroids[order[i]]);
+        }
+        glm::vec3 extent = centroidMax - centroidMin;
+        int axis = 0;
+        if (extent.y > extent[axis]) axis = 1;
+        if (extent.z > extent[axis]) axis = 2;
+
+        uint32_t middle = first;
+        if (task.depth < MEDIAN_SPLIT_DEPTH) {
+            // Binned SAH: cheapest split plane over all three axes
+            float bestCost = INF;
+            int bestAxis = -1, bestBin = 0;
+            for (int a = 0; a < 3; a++) {
+                if (extent[a] <= 0.0f) continue;
+                float scale = BIN_COUNT / extent[a];
+
+                Bin bins[BIN_COUNT];
+                for (uint32_t i = first; i < last; i++) {
+                    uint32_t prim = order[i];
+                    int b = std::min(BIN_COUNT - 1,
+                        (int)((centroids[prim][a] - centroidMin[a]) * scale));
+                    bins[b].count++;
+                    bins[b].grow(primMin[prim], primMax[prim]);
+                }
+
+                // Sweep from the right, then evaluate from the left
+                float rightArea[BIN_COUNT - 1];
+                uint32_t rightCount[BIN_COUNT - 1];
+                Bin right;
+                for (int b = BIN_COUNT - 1; b > 0; b--) {
+                    right.count += bins[b].count;
+                    right.grow(bins[b].boundsMin, bins[b].boundsMax);
+                    rightCount[b - 1] = right.count;
+                    rightArea[b - 1] = right.area();
+                }
+
+                Bin left;
+                for (int b = 0; b < BIN_COUNT - 1; b++) {
+                    left.count += bins[b].count;
+                    left.grow(bins[b].boundsMin, bins[b].boundsMax);
+                    if (left.count == 0 || rightCount[b] == 0) continue;
+
+                    float cost = left.count * left.area()
+                        + rightCount[b] * rightArea[b];
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = a;
+                        bestBin = b;
+                    }
+                }
+            }
+
+            if (bestAxis >= 0) {
+                float scale = BIN_COUNT / extent[bestAxis];
+                float origin = centroidMin[bestAxis];
+                middle = static_cast<uint32_t>(std::partition(
+                    order.begin() + first, order.begin() + last,
+                    [&](uint32_t prim) {
+                        int b = std::min(BIN_COUNT - 1, (int)(
+                            (centroids[prim][bestAxis] - origin) * scale));
+                        return b <= bestBin;
+                    }) - order.begin());
+            }
+        }
+
+        if (middle == first || middle == last) {
+            middle = first + (last - first) / 2;
+            std::nth_element(order.begin() + first, order.begin() + middle,
+                order.begin() + last, [&](uint32_t a, uint32_t b) {
+                    return centroids[a][axis] < centroids[b][axis];
+                });
+        }
+
+        uint32_t left = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(BvhNode());
+        nodes.push_back(BvhNode());
+        nodes[left].leftFirst = first;
+        nodes[left].count = middle - first;
+        nodes[left + 1].leftFirst = middle;
+        nodes[left + 1].count = last - middle;
+        updateBounds(nodes[left]);
+        updateBounds(nodes[left + 1]);
+
+        node.leftFirst = left;
+        node.count = 0;
+        tasks.push_back({ left, task.depth + 1 });
+        tasks.push_back({ left + 1, task.depth + 1 });
+    }
+
+    nodes.shrink_to_fit();
+}
+
+void transformBounds(const glm::mat4& m, const glm::vec3& boundsMin,
+    const glm::vec3& boundsMax, glm::vec3& outMin, glm::vec3& outMax) {
+    // Arvo: transformed center +- extents projected on |M|
+    glm::vec3 center = transformPoint(m, (boundsMin + boundsMax) * 0.5f);
+    glm::vec3 half = (boundsMax - boundsMin) * 0.5f;
+    glm::vec3 extent = glm::abs(glm::vec3(m[0])) * half.x
+        + glm::abs(glm::vec3(m[1])) * half.y
+        + glm::abs(glm::vec3(m[2])) * half.z;
+    outMin = center - extent;
+    outMax = center + extent;
+}
+
+float distanceSqToBox(const glm::vec3& p, const glm::vec3& boundsMin,
+    const glm::vec3& boundsMax) {
+    glm::vec3 d = glm::max(glm::max(boundsMin - p, p - boundsMax),
+        glm::vec3(0.0f));
+    return glm::dot(d, d);
+}
+
+// Ericson, Real-Time Collision Detection 5.1.5
+glm::vec3 closestPointOnTriangle(const glm::vec3& p, const glm::vec3& a,
+    const glm::vec3& b, const glm::vec3& c) {
+    glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) return b;
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+        return a + ab * (d1 / (d1 - d3));
+
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) return c;
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+        return a + ac * (d2 / (d2 - d6));
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    float denom = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+RayBoxTest::RayBoxTest(const Ray& ray) {
+    for (int i = 0; i < 3; i++) {
+        float d = ray.direction[i];
+        origin[i] = ray.origin[i];
+        invDir[i] = std::fabs(d) > 1.0f / MAX_INV_DIR ? 1.0f / d
+            : std::copysign(MAX_INV_DIR, d);
+    }
+    origin[3] = invDir[3] = 0.0f;
+}
+
+float RayBoxTest::intersect(const BvhNode& node, float maxT) const {
+#ifdef VENGINE_SSE
+    // xyz slabs at once. Lane 3 loads leftFirst/count, which as floats
+    // are denormals or NaNs: zero it before any arithmetic.
+    const __m128 xyz = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+    __m128 o = _mm_load_ps(origin);
+    __m128 inv = _mm_load_ps(invDir);
+    __m128 boundsMin = _mm_and_ps(_mm_loadu_ps(&node.boundsMin.x), xyz);
+    __m128 boundsMax = _mm_and_ps(_mm_loadu_ps(&node.boundsMax.x), xyz);
+    __m128 t1 = _mm_mul_ps(_mm_sub_ps(boundsMin, o), inv);
+    __m128 t2 = _mm_mul_ps(_mm_sub_ps(boundsMax, o), inv);
+    __m128 lo = _mm_min_ps(t1, t2);
+    __m128 hi = _mm_max_ps(t1, t2);
+    lo = _mm_max_ss(lo, _mm_shuffle_ps(lo, lo, _MM_SHUFFLE(1, 1, 1, 1)));
+    lo = _mm_max_ss(lo, _mm_shuffle_ps(lo, lo, _MM_SHUFFLE(2, 2, 2, 2)));
+    hi = _mm_min_ss(hi, _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(1, 1, 1, 1)));
+    hi = _mm_min_ss(hi, _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(2, 2, 2, 2)));
+    float tNear = _mm_cvtss_f32(lo);
+    float tFar = _mm_cvtss_f32(hi);
+#else
+    float tNear = -INF, tFar = INF;
+    for (int i = 0; i < 3; i++) {
+        float t1 = (node.boundsMin[i] - origin[i]) * invDir[i];
+        float t2 = (node.boundsMax[i] - origin[i]) * invDir[i];
+        tNear = std::max(tNear, std::min(t1, t2));
+        tFar = std::min(tFar, std::max(t1, t2));
+    }
+#endif
+    tNear = std::max(tNear, 0.0f);
+    return tNear <= tFar && tNear <= maxT ? tNear : -1.0f;
+}
+
+void MeshBvh::build(const std::vector<Vertex>& vertices,
+    const std::vector<unsigned int>& indices) {
+    size_t count = indices.size() / 3;
+    std::vector<glm::vec3> primMin(count), primMax(count);
+    for (size_t i = 0; i < count; i++) {
+        const glm::vec3& a = vertices[indices[i * 3 + 0]].position;
+        const glm::vec3& b = vertices[indices[i * 3 + 1]].position;
+        const glm::vec3& c = vertices[indices[i * 3 + 2]].position;
+        primMin[i] = glm::min(a, glm::min(b, c));
+        primMax[i] = glm::max(a, glm::max(b, c));
+    }
+
+    buildBvh(primMin, primMax, 4, m_nodes, m_triangleIds);
+
+    m_triangles.resize(count * 3);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t id = m_triangleIds[i];
+        for (int k = 0; k < 3; k++) {
+            m_triangles[i * 3 + k] = vertices[indices[id * 3 + k]].position;
+        }
+    }
+}
+
+bool MeshBvh::raycast(const Ray& ray, float maxT, TriangleHit& hit) const {
+    if (m_nodes.empty()) return false;
+
+    RayBoxTest box(ray);
+    if (box.intersect(m_nodes[0], maxT) < 0.0f) return false;
+
+    struct Entry { uint32_t node; float t; };
+    Entry stack[STACK_SIZE];
+    int size = 0;
+    uint32_t current = 0;
+    int64_t hitSlot = -1;
+
+    while (true) {
+        const BvhNode& node = m_nodes[current];
+        if (node.count) {
+            for (uint32_t i = 0; i < node.count; i++) {
+                uint32_t slot = node.leftFirst + i;
+                float t;
+                if (intersectTriangle(ray, &m_triangles[slot * 3], t)
+                    && t <= maxT) {
+                    maxT = t;
+                    hitSlot = slot;
+                }
+            }
+        }
+        else {
+            // Nearer child first, the other one is deferred
+            uint32_t nearChild = node.leftFirst;
+            uint32_t farChild = node.leftFirst + 1;
+            float tNear = box.intersect(m_nodes[nearChild], maxT);
+            float tFar = box.intersect(m_nodes[farChild], maxT);
+            if (tNear < 0.0f || (tFar >= 0.0f && tFar < tNear)) {
+                std::swap(nearChild, farChild);
+                std::swap(tNear, tFar);
+            }
+            if (tNear >= 0.0f) {
+                if (tFar >= 0.0f) stack[size++] = { farChild, tFar };
+                current = nearChild;
+                continue;
+            }
+        }
+
+        // Pop, skipping nodes that are now behind the closest hit
+        while (size > 0 && stack[size - 1].t > maxT) size--;
+        if (size == 0) break;
+        current = stack[--size].node;
+    }
+
+    if (hitSlot < 0) return false;
+
+    const glm::vec3* corners = &m_triangles[hitSlot * 3];
+    hit.t = maxT;
+    hit.triangle = m_triangleIds[hitSlot];
+    hit.normal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+    return true;
+}
+
+bool MeshBvh::raycastBruteForce(const Ray& ray, float maxT,
+    TriangleHit& hit) const {
+    int64_t hitSlot = -1;
+    for (size_t slot = 0; slot < m_triangleIds.size(); slot++) {
+        float t;
+        if (intersectTriangle(ray, &m_triangles[slot * 3], t) && t <= maxT) {
+            maxT = t;
+            hitSlot = slot;
+        }
+    }
+    if (hitSlot < 0) return false;
+
+    const glm::vec3* corners = &m_triangles[hitSlot * 3];
+    hit.t = maxT;
+    hit.triangle = m_triangleIds[hitSlot];
+    hit.normal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+    return true;
+}
+
+void MeshBvh::overlapSphere(const glm::mat4& toWorld,
+    const glm::vec3& center, float radius,
+    std::vector<uint32_t>& triangles) const {
+    if (m_nodes.empty()) return;
+
+    float radiusSq = radius * radius;
+    uint32_t stack[STACK_SIZE];
+    int size = 0;
+    stack[size++] = 0;
+
+    while (size > 0) {
+        const BvhNode& node = m_nodes[stack[--size]];
+        glm::vec3 boundsMin, boundsMax;
+        transformBounds(toWorld, node.boundsMin, node.boundsMax,
+            boundsMin, boundsMax);
+        if (distanceSqToBox(center, boundsMin, boundsMax) > radiusSq)
+            continue;
+
+        if (!node.count) {
+            stack[size++] = node.leftFirst;
+            stack[size++] = node.leftFirst + 1;
+            continue;
+        }
+
+        for (uint32_t i = 0; i < node.count; i++) {
+            uint32_t slot = node.leftFirst + i;
+            const glm::vec3* corners = &m_triangles[slot * 3];
+            glm::vec3 p = closestPointOnTriangle(center,
+                transformPoint(toWorld, corners[0]),
+                transformPoint(toWorld, corners[1]),
+                transformPoint(toWorld, corners[2]));
+            glm::vec3 d = p - center;
+            if (glm::dot(d, d) <= radiusSq) {
+                triangles.push_back(m_triangleIds[slot]);
+            }
+        }
+    }
+}
+
+bool MeshBvh::nearestPoint(const glm::mat4& toWorld, const glm::vec3& point,
+    float& bestDistanceSq, glm::vec3& closest, uint32_t& triangle) const {
+    if (m_nodes.empty()) return false;
+
+    auto nodeDistance = [&](uint32_t index) {
+        glm::vec3 boundsMin, boundsMax;
+        transformBounds(toWorld, m_nodes[index].boundsMin,
+            m_nodes[index].boundsMax, boundsMin, boundsMax);
+        return distanceSqToBox(point, boundsMin, boundsMax);
+    };
+
+    struct Entry { uint32_t node; float distanceSq; };
+    Entry stack[STACK_SIZE];
+    int size = 0;
+    stack[size++] = { 0, nodeDistance(0) };
+    bool found = false;
+
+    while (size > 0) {
+        Entry entry = stack[--size];
+        if (entry.distanceSq >= bestDistanceSq) continue;
+        const BvhNode& node = m_nodes[entry.node];
+
+        if (!node.count) {
+            // Push the farther child first so the nearer one is popped next
+            uint32_t a = node.leftFirst, b = node.leftFirst + 1;
+            float da = nodeDistance(a), db = nodeDistance(b);
+            if (da < db) {
+                std::swap(a, b);
+                std::swap(da, db);
+            }
+            stack[size++] = { a, da };
+            stack[size++] = { b, db };
+            continue;
+        }
+
+        for (uint32_t i = 0; i < node.count; i++) {
+            uint32_t slot = node.leftFirst + i;
+            const glm::vec3* corners = &m_triangles[slot * 3];
+            glm::vec3 p = closestPointOnTriangle(point,
+                transformPoint(toWorld, corners[0]),
+                transformPoint(toWorld, corners[1]),
+                transformPoint(toWorld, corners[2]));
+            glm::vec3 d = p - point;
+            float distanceSq = glm::dot(d, d);
+            if (distanceSq < bestDistanceSq) {
+                bestDistanceSq = distanceSq;
+                closest = p;
+                triangle = m_triangleIds[slot];
+                found = true;
+            }
+        }
+    }
+    return found;
+}
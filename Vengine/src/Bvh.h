@@ -0,0 +1,87 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+struct Vertex;
+
+// t is measured in units of direction, which need not be normalized
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+};
+
+// Flattened node, two per cache line. Interior nodes (count == 0) keep
+// their children at leftFirst and leftFirst + 1; leaves own the
+// primitives [leftFirst, leftFirst + count).
+struct BvhNode {
+    glm::vec3 boundsMin;
+    uint32_t leftFirst;
+    glm::vec3 boundsMax;
+    uint32_t count;
+};
+
+struct TriangleHit {
+    float t = 0.0f;
+    uint32_t triangle = 0;    // index into the mesh's triangle list
+    glm::vec3 normal;         // geometric, unnormalized, mesh space
+};
+
+// Triangle BVH of one mesh, built with the binned surface area heuristic.
+// Triangles are copied in leaf order so traversal reads them linearly.
+class MeshBvh {
+public:
+    void build(const std::vector<Vertex>& vertices,
+        const std::vector<unsigned int>& indices);
+
+    bool empty() const { return m_nodes.empty(); }
+    size_t getTriangleCount() const { return m_triangleIds.size(); }
+    size_t getNodeCount() const { return m_nodes.size(); }
+
+    // Closest hit with t in [0, maxT], in mesh space
+    bool raycast(const Ray& ray, float maxT, TriangleHit& hit) const;
+    // Same result by testing every triangle; reference for benchmarks
+    bool raycastBruteForce(const Ray& ray, float maxT,
+        TriangleHit& hit) const;
+
+    // Queries in world space for a mesh placed by toWorld; triangles are
+    // tested after transformation, so non-uniform scale is exact
+    void overlapSphere(const glm::mat4& toWorld, const glm::vec3& center,
+        float radius, std::vector<uint32_t>& triangles) const;
+    // Improves on bestDistanceSq; returns true if a closer point was found
+    bool nearestPoint(const glm::mat4& toWorld, const glm::vec3& point,
+        float& bestDistanceSq, glm::vec3& closest,
+        uint32_t& triangle) const;
+
+private:
+    std::vector<BvhNode> m_nodes;
+    std::vector<glm::vec3> m_triangles;     // 3 corners per triangle
+    std::vector<uint32_t> m_triangleIds;    // leaf order -> mesh order
+};
+
+// Builds nodes over primitive bounds; `order` receives the primitive
+// permutation that leaf ranges refer to. Leaves never hold more than
+// maxLeafSize primitives (coincident centroids split at the median).
+void buildBvh(const std::vector<glm::vec3>& primMin,
+    const std::vector<glm::vec3>& primMax, uint32_t maxLeafSize,
+    std::vector<BvhNode>& nodes, std::vector<uint32_t>& order);
+
+// Axis-aligned bounds of a transformed box
+void transformBounds(const glm::mat4& m, const glm::vec3& boundsMin,
+    const glm::vec3& boundsMax, glm::vec3& outMin, glm::vec3& outMax);
+
+float distanceSqToBox(const glm::vec3& p, const glm::vec3& boundsMin,
+    const glm::vec3& boundsMax);
+
+glm::vec3 closestPointOnTriangle(const glm::vec3& p, const glm::vec3& a,
+    const glm::vec3& b, const glm::vec3& c);
+
+// Slab test against one node, SSE when available. Returns the entry
+// distance, or a negative value on a miss.
+struct RayBoxTest {
+    RayBoxTest(const Ray& ray);
+    float intersect(const BvhNode& node, float maxT) const;
+
+    alignas(16) float origin[4];
+    alignas(16) float invDir[4];
+};
@@ -0,0 +1,161 @@
+#include "DynamicResolution.h"
+#include <algorithm>
+
+const float DynamicResolution::SCALES[SCALE_COUNT] = {
+    0.5f, 0.625f, 0.75f, 0.875f, 1.0f
+};
+
+DynamicResolution::DynamicResolution(float targetFrameMs)
+    : m_targetMs(targetFrameMs),
+    m_fxaaShader("assets/shaders/fullscreen.vert",
+        "assets/shaders/fxaa.frag")
+{
+    glGenQueries(QUERY_COUNT, m_queries);
+    // Core profile needs a bound VAO even for attribute-less draws
+    glGenVertexArrays(1, &m_emptyVAO);
+}
+
+DynamicResolution::~DynamicResolution() {
+    for (auto& target : m_targets) {
+        target.cleanup();
+    }
+    glDeleteQueries(QUERY_COUNT, m_queries);
+    glDeleteVertexArrays(1, &m_emptyVAO);
+}
+
+void DynamicResolution::setAntiAliasing(AntiAliasing mode, int msaaSamples) {
+    int samples = 1;
+    if (mode == AntiAliasing::MSAA) {
+        GLint maxSamples = 1;
+        glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+        samples = std::max(1, std::min(msaaSamples, (int)maxSamples));
+    }
+    if (mode == m_mode && samples == m_samples) return;
+
+    m_mode = mode;
+    m_samples = samples;
+    rebuildTargets();
+}
+
+void DynamicResolution::setEnabled(bool enabled) {
+    m_enabled = enabled;
+    if (!enabled) m_level = SCALE_COUNT - 1;
+}
+
+void DynamicResolution::rebuildTargets() {
+    for (auto& target : m_targets) {
+        target.cleanup();
+    }
+    m_targets.clear();
+    if (m_windowWidth <= 0 || m_windowHeight <= 0) return;
+
+    m_targets.resize(SCALE_COUNT);
+    for (int i = 0; i < SCALE_COUNT; i++) {
+        int width = std::max(1, (int)(m_windowWidth * SCALES[i]));
+        int height = std::max(1, (int)(m_windowHeight * SCALES[i]));
+        m_targets[i].create(width, height, m_samples);
+    }
+}
+
+void DynamicResolution::readTimers() {
+    for (int i = 0; i < QUERY_COUNT; i++) {
+        if (!m_queryPending[i]) continue;
+
+        GLint available = 0;
+        glGetQueryObjectiv(m_queries[i], GL_QUERY_RESULT_AVAILABLE,
+            &available);
+        if (!available) continue;
+
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(m_queries[i], GL_QUERY_RESULT, &ns);
+        m_queryPending[i] = false;
+
+        float ms = ns / 1000000.0f;
+        m_gpuMs = m_gpuMs > 0.0f ? m_gpuMs * 0.9f + ms * 0.1f : ms;
+    }
+}
+
+void DynamicResolution::adjustScale() {
+    if (!m_enabled || m_gpuMs <= 0.0f) return;
+    if (m_cooldown > 0) {
+        m_cooldown--;
+        return;
+    }
+
+    // GPU cost is assumed proportional to pixel count
+    if (m_gpuMs > m_targetMs && m_level > 0) {
+        m_level--;
+        m_cooldown = COOLDOWN_FRAMES;
+    }
+    else if (m_level < SCALE_COUNT - 1) {
+        float ratio = SCALES[m_level + 1] / SCALES[m_level];
+        if (m_gpuMs * ratio * ratio < m_targetMs * 0.9f) {
+            m_level++;
+            m_cooldown = COOLDOWN_FRAMES;
+        }
+    }
+}
+
+void DynamicResolution::beginFrame(int windowWidth, int windowHeight) {
+    if (windowWidth != m_windowWidth || windowHeight != m_windowHeight) {
+        m_windowWidth = windowWidth;
+        m_windowHeight = windowHeight;
+        rebuildTargets();
+    }
+
+    readTimers();
+    adjustScale();
+
+    if (m_targets.empty()) return;
+    m_targets[m_level].bind();
+
+    // Skip timing if that query's result was not read back yet
+    m_timing = !m_queryPending[m_queryIndex];
+    if (m_timing) {
+        glBeginQuery(GL_TIME_ELAPSED, m_queries[m_queryIndex]);
+    }
+}
+
+void DynamicResolution::endFrame() {
+    if (m_timing) {
+        glEndQuery(GL_TIME_ELAPSED);
+        m_queryPending[m_queryIndex] = true;
+        m_queryIndex = (m_queryIndex + 1) % QUERY_COUNT;
+        m_timing = false;
+    }
+
+    if (m_targets.empty()) return;
+    const RenderTarget& target = m_targets[m_level];
+    target.resolve();
+
+    if (m_mode == AntiAliasing::FXAA) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, m_windowWidth, m_windowHeight);
+        glDisable(GL_DEPTH_TEST);
+
+        m_fxaaShader.use();
+        m_fxaaShader.setInt("screenTexture", 0);
+        // Longer than the small-string buffer: no std::string per frame
+        glUniform2f(glGetUniformLocation(m_fxaaShader.ID,
+            "inverseScreenSize"), 1.0f / target.getWidth(),
+            1.0f / target.getHeight());
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, target.getColorTexture());
+
+        glBindVertexArray(m_emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+
+        glEnable(GL_DEPTH_TEST);
+    }
+    else {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER,
+            target.getResolveFramebuffer());
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, target.getWidth(), target.getHeight(),
+            0, 0, m_windowWidth, m_windowHeight,
+            GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, m_windowWidth, m_windowHeight);
+    }
+}
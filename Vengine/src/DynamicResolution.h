@@ -0,0 +1,68 @@
+#pragma once
+#include "RenderTarget.h"
+#include "Shader.h"
+#include <glad/glad.h>
+#include <vector>
+
+enum class AntiAliasing {
+    None,
+    MSAA,   // multisample render targets, resolved before upscaling
+    FXAA    // post-process pass applied while upscaling
+};
+
+// Renders the scene offscreen at a scaled internal resolution and
+// upscales to the window. The scale follows GPU timer queries to hold
+// the target frame time. One render target per scale step is allocated
+// up front; they are only rebuilt on window resize or AA change.
+class DynamicResolution {
+public:
+    explicit DynamicResolution(float targetFrameMs = 16.6f);
+    ~DynamicResolution();
+
+    DynamicResolution(const DynamicResolution&) = delete;
+    DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+    void setTargetFrameTime(float ms) { m_targetMs = ms; }
+    void setAntiAliasing(AntiAliasing mode, int msaaSamples = 4);
+    // Disabled: always render at full window resolution
+    void setEnabled(bool enabled);
+
+    // Binds the offscreen target for the scene
+    void beginFrame(int windowWidth, int windowHeight);
+    // Resolves, upscales into the default framebuffer
+    void endFrame();
+
+    float getScale() const { return SCALES[m_level]; }
+    float getGpuTime() const { return m_gpuMs; }
+    AntiAliasing getAntiAliasing() const { return m_mode; }
+
+private:
+    static const int SCALE_COUNT = 5;
+    static const float SCALES[SCALE_COUNT];
+    static const int QUERY_COUNT = 4;
+    static const int COOLDOWN_FRAMES = 15;
+
+    std::vector<RenderTarget> m_targets;
+    AntiAliasing m_mode = AntiAliasing::None;
+    int m_samples = 1;
+    int m_windowWidth = 0;
+    int m_windowHeight = 0;
+
+    bool m_enabled = true;
+    float m_targetMs;
+    float m_gpuMs = 0.0f;
+    int m_level = SCALE_COUNT - 1;
+    int m_cooldown = 0;
+
+    GLuint m_queries[QUERY_COUNT];
+    bool m_queryPending[QUERY_COUNT] = {};
+    int m_queryIndex = 0;
+    bool m_timing = false;
+
+    Shader m_fxaaShader;
+    GLuint m_emptyVAO = 0;
+
+    void rebuildTargets();
+    void readTimers();
+    void adjustScale();
+};
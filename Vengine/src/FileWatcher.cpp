@@ -0,0 +1,147 @@
+#include "FileWatcher.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <climits>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    std::string parentDirectory(const std::string& path) {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? "." : path.substr(0, slash);
+    }
+}
+
+std::string FileWatcher::normalize(const std::string& path) {
+    std::string result = path;
+#ifdef _WIN32
+    char buffer[_MAX_PATH];
+    if (_fullpath(buffer, path.c_str(), _MAX_PATH)) result = buffer;
+#else
+    // Missing files keep their relative path
+    char* resolved = realpath(path.c_str(), nullptr);
+    if (resolved) {
+        result = resolved;
+        std::free(resolved);
+    }
+#endif
+    std::replace(result.begin(), result.end(), '\\', '/');
+    return result;
+}
+
+#ifdef __linux__
+
+FileWatcher::FileWatcher() {
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+        std::cerr << "FileWatcher: inotify unavailable, hot reload is off"
+            << std::endl;
+    }
+}
+
+FileWatcher::~FileWatcher() {
+    if (m_fd >= 0) close(m_fd);
+}
+
+void FileWatcher::watch(const std::string& path) {
+    std::string file = normalize(path);
+    m_files.insert(file);
+
+    std::string directory = parentDirectory(file);
+    if (m_fd < 0 || m_watchedDirectories.count(directory)) return;
+
+    int wd = inotify_add_watch(m_fd, directory.c_str(),
+        IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd < 0) {
+        std::cerr << "FileWatcher: cannot watch " << directory << std::endl;
+        return;
+    }
+    m_directories[wd] = directory;
+    m_watchedDirectories.insert(directory);
+}
+
+void FileWatcher::unwatch(const std::string& path) {
+    // The directory stays watched; its other events are filtered out
+    m_files.erase(normalize(path));
+}
+
+std::vector<std::string> FileWatcher::poll() {
+    std::unordered_set<std::string> changed;
+    if (m_fd >= 0) {
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = read(m_fd, buffer, sizeof(buffer))) > 0) {
+            for (char* p = buffer; p < buffer + length;) {
+                const inotify_event* event =
+                    reinterpret_cast<const inotify_event*>(p);
+                p += sizeof(inotify_event) + event->len;
+
+                // Events were dropped: treat everything as changed
+                if (event->mask & IN_Q_OVERFLOW) {
+                    changed.insert(m_files.begin(), m_files.end());
+                    continue;
+                }
+                auto directory = m_directories.find(event->wd);
+                if (directory == m_directories.end() || !event->len)
+                    continue;
+
+                std::string file = directory->second + "/" + event->name;
+                if (m_files.count(file)) changed.insert(file);
+            }
+        }
+    }
+    return std::vector<std::string>(changed.begin(), changed.end());
+}
+
+#else
+
+FileWatcher::FileWatcher()
+    : m_lastPoll(std::chrono::steady_clock::now()) {
+}
+
+FileWatcher::~FileWatcher() {
+}
+
+FileWatcher::FileState FileWatcher::readState(const std::string& path) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) return FileState{ -1, -1 };
+    return FileState{ (long long)info.st_mtime, (long long)info.st_size };
+}
+
+void FileWatcher::watch(const std::string& path) {
+    std::string file = normalize(path);
+    if (m_files.insert(file).second) m_states[file] = readState(file);
+}
+
+void FileWatcher::unwatch(const std::string& path) {
+    std::string file = normalize(path);
+    m_files.erase(file);
+    m_states.erase(file);
+}
+
+std::vector<std::string> FileWatcher::poll() {
+    std::vector<std::string> changed;
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_lastPoll < std::chrono::milliseconds(POLL_INTERVAL_MS))
+        return changed;
+    m_lastPoll = now;
+
+    for (const auto& file : m_files) {
+        FileState state = readState(file);
+        FileState& last = m_states[file];
+        // A missing file (mid-save) is reported once it is back
+        if (state.time < 0) continue;
+        if (state.time != last.time || state.size != last.size) {
+            changed.push_back(file);
+        }
+        last = state;
+    }
+    return changed;
+}
+
+#endif
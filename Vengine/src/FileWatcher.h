@@ -0,0 +1,48 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Reports watched files that were written since the last poll().
+// Linux: inotify on the parent directories, so editors that save by
+// writing a temporary file and renaming it are seen too. Elsewhere the
+// modification times are compared, at most every POLL_INTERVAL.
+class FileWatcher {
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // Paths are normalized; watching a file twice is harmless
+    void watch(const std::string& path);
+    void unwatch(const std::string& path);
+    // Normalized paths, each changed file once; never blocks
+    std::vector<std::string> poll();
+
+    // Absolute path with forward slashes
+    static std::string normalize(const std::string& path);
+
+private:
+    std::unordered_set<std::string> m_files;
+
+#ifdef __linux__
+    int m_fd = -1;
+    std::unordered_map<int, std::string> m_directories;
+    std::unordered_set<std::string> m_watchedDirectories;
+#else
+    struct FileState {
+        long long time;
+        long long size;
+    };
+    static const int POLL_INTERVAL_MS = 250;
+
+    std::unordered_map<std::string, FileState> m_states;
+    std::chrono::steady_clock::time_point m_lastPoll;
+
+    static FileState readState(const std::string& path);
+#endif
+};
@@ -0,0 +1,45 @@
+#include "FrameArena.h"
+#include <algorithm>
+#include <cstdint>
+
+FrameArena::FrameArena(size_t capacity) {
+    addBlock(capacity);
+}
+
+void FrameArena::addBlock(size_t size) {
+    Block block;
+    block.data.reset(new unsigned char[size]);
+    block.size = size;
+    m_blocks.push_back(std::move(block));
+    m_capacity += size;
+    m_offset = 0;
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment) {
+    Block& block = m_blocks.back();
+    uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+    uintptr_t start = (base + m_offset + alignment - 1)
+        & ~(uintptr_t)(alignment - 1);
+    size_t end = start - base + size;
+
+    if (end > block.size) {
+        // Overflow: chain a block big enough for the rest of the frame
+        addBlock(std::max(size + alignment, m_capacity));
+        return allocate(size, alignment);
+    }
+
+    m_used += end - m_offset;
+    m_offset = end;
+    return reinterpret_cast<void*>(start);
+}
+
+void FrameArena::reset() {
+    if (m_blocks.size() > 1) {
+        size_t capacity = m_capacity;
+        m_blocks.clear();
+        m_capacity = 0;
+        addBlock(capacity);
+    }
+    m_offset = 0;
+    m_used = 0;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Linear allocator for per-frame temporaries (visible sets, sort keys,
+// command lists). reset() once per frame; memory is never freed per
+// allocation. If a frame overflows, an extra block is chained and the
+// next reset() merges everything into one block, so steady-state frames
+// do not touch the heap.
+class FrameArena {
+public:
+    explicit FrameArena(size_t capacity = 1 << 20);
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    template <typename T>
+    T* allocate(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value,
+            "FrameArena never runs destructors");
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    void reset();
+
+    size_t getCapacity() const { return m_capacity; }
+    size_t getUsed() const { return m_used; }
+
+private:
+    struct Block {
+        std::unique_ptr<unsigned char[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> m_blocks;
+    size_t m_offset = 0;   // inside m_blocks.back()
+    size_t m_used = 0;     // whole frame
+    size_t m_capacity = 0;
+
+    void addBlock(size_t size);
+};
+
+// Fixed-capacity list living in a FrameArena
+template <typename T>
+struct FrameList {
+    T* data = nullptr;
+    size_t size = 0;
+    size_t capacity = 0;
+
+    FrameList() = default;
+    FrameList(FrameArena& arena, size_t capacity)
+        : data(arena.allocate<T>(capacity)), capacity(capacity) {}
+
+    void push_back(const T& value) {
+        assert(size < capacity);
+        data[size++] = value;
+    }
+
+    T& operator[](size_t i) { return data[i]; }
+    const T& operator[](size_t i) const { return data[i]; }
+
+    T* begin() { return data; }
+    T* end() { return data + size; }
+    const T* begin() const { return data; }
+    const T* end() const { return data + size; }
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// View frustum planes (xyz = normal pointing inside, w = distance),
+// extracted from a projection * view matrix (Gribb/Hartmann)
+struct Frustum {
+    glm::vec4 planes[6];
+
+    static Frustum fromMatrix(const glm::mat4& m) {
+        Frustum f;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 4; j++) {
+                f.planes[i * 2][j] = m[j][3] + m[j][i];
+                f.planes[i * 2 + 1][j] = m[j][3] - m[j][i];
+            }
+        }
+        for (auto& p : f.planes) {
+            p = p / glm::length(glm::vec3(p));
+        }
+        return f;
+    }
+
+    bool intersectsSphere(const glm::vec3& center, float radius) const {
+        for (const auto& p : planes) {
+            if (glm::dot(glm::vec3(p), center) + p.w < -radius)
+                return false;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,313 @@
+#include "GpuScene.h"
+#include "Frustum.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace {
+    GLuint diffuseTexture(const Mesh& mesh) {
+        for (const auto& texture : mesh.textures) {
+            if (texture.type == "texture_diffuse") return texture.id;
+        }
+        return 0;
+    }
+
+    // Offset or stride of an SSBO member as the driver laid it out
+    GLint bufferVariable(GLuint program, const char* name, GLenum property) {
+        GLuint index = glGetProgramResourceIndex(program, GL_BUFFER_VARIABLE,
+            name);
+        if (index == GL_INVALID_INDEX) return -1;
+        GLint value = -1;
+        glGetProgramResourceiv(program, GL_BUFFER_VARIABLE, index, 1,
+            &property, 1, nullptr, &value);
+        return value;
+    }
+}
+
+GpuScene::Transform GpuScene::makeTransform(const glm::mat4& model) {
+    // The normal matrix is built once per update, not once per vertex
+    glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(model)));
+    Transform transform;
+    transform.model = model;
+    for (int i = 0; i < 3; i++) {
+        transform.normal[i] = glm::vec4(normal[i], 0.0f);
+    }
+    return transform;
+}
+
+GpuScene::GpuScene()
+    : m_cullShader("assets/shaders/cull.comp"),
+    m_ssboAlignment(StreamBuffer::offsetAlignment(GL_SHADER_STORAGE_BUFFER))
+{
+    checkLayout();
+}
+
+GpuScene::~GpuScene() {
+    release();
+}
+
+bool GpuScene::isSupported() {
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+int GpuScene::addInstance(const Model& model) {
+    m_instances.push_back(&model);
+    m_transforms.push_back(makeTransform(model.getModelMatrix()));
+    return static_cast<int>(m_instances.size()) - 1;
+}
+
+void GpuScene::setTransform(int instance, const glm::mat4& transform) {
+    m_transforms[instance] = makeTransform(transform);
+}
+
+void GpuScene::build() {
+    release();
+
+    struct Range { GLuint firstIndex; GLint baseVertex; };
+
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::unordered_map<const Model*, std::vector<Range>> ranges;
+
+    // Geometry of each model is stored once, whatever the instance count
+    for (const Model* model : m_instances) {
+        if (ranges.count(model)) continue;
+
+        auto& meshRanges = ranges[model];
+        for (const auto& mesh : model->getMeshes()) {
+            meshRanges.push_back({
+                static_cast<GLuint>(indices.size()),
+                static_cast<GLint>(vertices.size()) });
+            vertices.insert(vertices.end(),
+                mesh.vertices.begin(), mesh.vertices.end());
+            indices.insert(indices.end(),
+                mesh.indices.begin(), mesh.indices.end());
+        }
+    }
+
+    // One draw per (instance, mesh), grouped by material
+    struct Draw { GLuint texture; DrawInfo info; };
+    std::vector<Draw> draws;
+
+    for (size_t i = 0; i < m_instances.size(); i++) {
+        const auto& meshes = m_instances[i]->getMeshes();
+        const auto& meshRanges = ranges[m_instances[i]];
+
+        for (size_t j = 0; j < meshes.size(); j++) {
+            const Mesh& mesh = meshes[j];
+            glm::vec3 center = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+            float radius = glm::length(mesh.boundsMax - mesh.boundsMin)
+                * 0.5f;
+
+            Draw draw;
+            draw.texture = diffuseTexture(mesh);
+            draw.info.sphere = glm::vec4(center, radius);
+            draw.info.indexCount = static_cast<GLuint>(mesh.indices.size());
+            draw.info.firstIndex = meshRanges[j].firstIndex;
+            draw.info.baseVertex = meshRanges[j].baseVertex;
+            draw.info.instance = static_cast<GLuint>(i);
+            draws.push_back(draw);
+        }
+    }
+
+    std::stable_sort(draws.begin(), draws.end(),
+        [](const Draw& a, const Draw& b) { return a.texture < b.texture; });
+
+    std::vector<DrawInfo> drawInfos;
+    for (const auto& draw : draws) {
+        if (m_batches.empty() || m_batches.back().texture != draw.texture) {
+            m_batches.push_back({ draw.texture,
+                static_cast<GLsizei>(drawInfos.size()), 0 });
+        }
+        m_batches.back().count++;
+        drawInfos.push_back(draw.info);
+    }
+    m_drawCount = static_cast<GLsizei>(drawInfos.size());
+
+    // Per-instance attribute: baseInstance selects the draw record
+    std::vector<GLuint> drawIds(m_drawCount);
+    for (GLsizei i = 0; i < m_drawCount; i++) drawIds[i] = i;
+
+    glGenVertexArrays(1, &m_VAO);
+    glGenBuffers(1, &m_VBO);
+    glGenBuffers(1, &m_EBO);
+    glGenBuffers(1, &m_drawIdBuffer);
+    glGenBuffers(1, &m_drawBuffer);
+    glGenBuffers(1, &m_commandBuffer);
+
+    glBindVertexArray(m_VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
+        vertices.data(), GL_STATIC_DRAW);
+    Mesh::setupVertexAttributes();
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_drawIdBuffer);
+    glBufferData(GL_ARRAY_BUFFER, drawIds.size() * sizeof(GLuint),
+        drawIds.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(5);
+    glVertexAttribIPointer(5, 1, GL_UNSIGNED_INT, sizeof(GLuint),
+        (void*)0);
+    glVertexAttribDivisor(5, 1);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+        indices.size() * sizeof(unsigned int),
+        indices.data(), GL_STATIC_DRAW);
+
+    glBindVertexArray(0);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+        drawInfos.size() * sizeof(DrawInfo),
+        drawInfos.data(), GL_STATIC_DRAW);
+
+    // Written by the compute pass, consumed as GL_DRAW_INDIRECT_BUFFER
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+        m_drawCount * sizeof(DrawCommand), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // Whole alignment units, so each frame region starts bindable
+    GLsizeiptr transformSize = m_transforms.size() * sizeof(Transform);
+    GLsizeiptr regionSize = (transformSize + m_ssboAlignment - 1)
+        / m_ssboAlignment * m_ssboAlignment;
+    m_transformBuffer = std::make_unique<StreamBuffer>(
+        GL_SHADER_STORAGE_BUFFER, regionSize);
+
+    std::cout << "GPU scene: " << m_drawCount << " draws, "
+        << m_batches.size() << " batches" << std::endl;
+}
+
+void GpuScene::cull(const glm::mat4& viewProjection) {
+    if (m_drawCount == 0) return;
+
+    // The region holds one frame of transforms: a second cull before
+    // endFrame() overflows it (and throws) instead of racing the GPU
+    GLsizeiptr size = m_transforms.size() * sizeof(Transform);
+    if (!m_frameOpen) {
+        m_transformBuffer->beginFrame();
+        m_frameOpen = true;
+    }
+    auto alloc = m_transformBuffer->allocate(size, m_ssboAlignment);
+    assert(alloc.offset % m_ssboAlignment == 0);
+    std::memcpy(alloc.data, m_transforms.data(), size);
+    m_transformBuffer->flush();
+    m_transformOffset = alloc.offset;
+
+    bindBuffers();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_commandBuffer);
+
+    Frustum frustum = Frustum::fromMatrix(viewProjection);
+
+    m_cullShader.use();
+    glUniform4fv(glGetUniformLocation(m_cullShader.ID, "frustumPlanes"),
+        6, &frustum.planes[0].x);
+    m_cullShader.setInt("drawCount", m_drawCount);
+
+    glDispatchCompute((m_drawCount + 63) / 64, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void GpuScene::draw(Shader& shader) {
+    if (m_drawCount == 0 || m_transformOffset < 0) return;
+
+    // Other passes may have rebound the indexed SSBO bindings since cull()
+    bindBuffers();
+
+    // Longer than the small-string buffer: no std::string per frame
+    glUniform1i(glGetUniformLocation(shader.ID, "texture_diffuse1"), 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindVertexArray(m_VAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+
+    for (const auto& batch : m_batches) {
+        shader.setBool("useTexture", batch.texture != 0);
+        glBindTexture(GL_TEXTURE_2D, batch.texture);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+            (void*)(batch.first * sizeof(DrawCommand)), batch.count, 0);
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void GpuScene::endFrame() {
+    if (!m_frameOpen) return;
+    m_transformBuffer->endFrame();
+    m_frameOpen = false;
+}
+
+void GpuScene::bindBuffers() const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_drawBuffer);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 1,
+        m_transformBuffer->getID(), m_transformOffset,
+        m_transforms.size() * sizeof(Transform));
+}
+
+void GpuScene::checkLayout() const {
+    // Draw commands are read with stride 0, i.e. tightly packed
+    static_assert(sizeof(DrawCommand) == 5 * sizeof(GLuint),
+        "DrawCommand must match the indirect command layout");
+
+    struct Member {
+        const char* name;
+        GLenum property;
+        size_t expected;
+    };
+    const Member members[] = {
+        { "draws[0].sphere", GL_OFFSET, offsetof(DrawInfo, sphere) },
+        { "draws[0].indexCount", GL_OFFSET, offsetof(DrawInfo, indexCount) },
+        { "draws[0].firstIndex", GL_OFFSET, offsetof(DrawInfo, firstIndex) },
+        { "draws[0].baseVertex", GL_OFFSET, offsetof(DrawInfo, baseVertex) },
+        { "draws[0].instance", GL_OFFSET, offsetof(DrawInfo, instance) },
+        { "draws[0].sphere", GL_TOP_LEVEL_ARRAY_STRIDE, sizeof(DrawInfo) },
+        { "commands[0].count", GL_OFFSET, offsetof(DrawCommand, count) },
+        { "commands[0].instanceCount", GL_OFFSET,
+            offsetof(DrawCommand, instanceCount) },
+        { "commands[0].firstIndex", GL_OFFSET,
+            offsetof(DrawCommand, firstIndex) },
+        { "commands[0].baseVertex", GL_OFFSET,
+            offsetof(DrawCommand, baseVertex) },
+        { "commands[0].baseInstance", GL_OFFSET,
+            offsetof(DrawCommand, baseInstance) },
+        { "commands[0].count", GL_TOP_LEVEL_ARRAY_STRIDE,
+            sizeof(DrawCommand) },
+        { "transforms[0].model", GL_OFFSET, offsetof(Transform, model) },
+        { "transforms[0].normal", GL_OFFSET, offsetof(Transform, normal) },
+        { "transforms[0].normal", GL_MATRIX_STRIDE, sizeof(glm::vec4) },
+        { "transforms[0].model", GL_TOP_LEVEL_ARRAY_STRIDE,
+            sizeof(Transform) },
+    };
+
+    for (const auto& member : members) {
+        GLint value = bufferVariable(m_cullShader.ID, member.name,
+            member.property);
+        if (value != static_cast<GLint>(member.expected)) {
+            throw std::runtime_error(std::string("GpuScene: ")
+                + member.name + " does not match the std430 layout");
+        }
+    }
+}
+
+void GpuScene::release() {
+    if (m_VAO) {
+        glDeleteVertexArrays(1, &m_VAO);
+        GLuint buffers[] = { m_VBO, m_EBO, m_drawIdBuffer,
+            m_drawBuffer, m_commandBuffer };
+        glDeleteBuffers(5, buffers);
+    }
+    m_VAO = m_VBO = m_EBO = 0;
+    m_drawIdBuffer = m_drawBuffer = m_commandBuffer = 0;
+    m_transformBuffer.reset();
+    m_transformOffset = -1;
+    m_frameOpen = false;
+    m_batches.clear();
+    m_drawCount = 0;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "Model.h"
+#include "Shader.h"
+#include "StreamBuffer.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+// GPU-driven path (GL 4.3+): geometry of all instances is merged into
+// one VAO, a compute shader frustum-culls every mesh and writes the
+// indirect commands, then each material batch is a single
+// glMultiDrawElementsIndirect. Use the regular Model::draw path on 3.3.
+class GpuScene {
+public:
+    GpuScene();
+    ~GpuScene();
+
+    GpuScene(const GpuScene&) = delete;
+    GpuScene& operator=(const GpuScene&) = delete;
+
+    static bool isSupported();
+
+    // Registers an instance of a model; geometry is merged in build()
+    int addInstance(const Model& model);
+    void build();
+
+    void setTransform(int instance, const glm::mat4& transform);
+
+    // Uploads transforms and runs the culling compute pass; once per
+    // frame, the transforms get a new stream buffer region each frame
+    void cull(const glm::mat4& viewProjection);
+    // Draws with a shader built from indirect.vert, using the commands
+    // and transforms of the last cull(); may be called several times
+    void draw(Shader& shader);
+    // Fences this frame's transforms; call after the frame's last draw
+    void endFrame();
+
+private:
+    // Layouts match cull.comp / indirect.vert (std430), see checkLayout()
+    struct DrawInfo {
+        glm::vec4 sphere;       // local-space center + radius
+        GLuint indexCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint instance;
+    };
+
+    // mat3 in std430 is three vec4 columns
+    struct Transform {
+        glm::mat4 model;
+        glm::vec4 normal[3];
+    };
+
+    struct DrawCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    struct Batch {
+        GLuint texture;         // diffuse texture, 0 if none
+        GLsizei first;
+        GLsizei count;
+    };
+
+    Shader m_cullShader;
+    std::vector<const Model*> m_instances;
+    std::vector<Transform> m_transforms;
+    std::vector<Batch> m_batches;
+    GLsizei m_drawCount = 0;
+
+    GLuint m_VAO = 0;
+    GLuint m_VBO = 0;
+    GLuint m_EBO = 0;
+    GLuint m_drawIdBuffer = 0;
+    GLuint m_drawBuffer = 0;
+    GLuint m_commandBuffer = 0;
+
+    std::unique_ptr<StreamBuffer> m_transformBuffer;
+    GLsizeiptr m_ssboAlignment;
+    GLintptr m_transformOffset = -1;    // region of the last cull()
+    bool m_frameOpen = false;           // region not fenced yet
+
+    static Transform makeTransform(const glm::mat4& model);
+    // Throws if the structs above disagree with the compiled cull.comp
+    void checkLayout() const;
+    void bindBuffers() const;
+    void release();
+};
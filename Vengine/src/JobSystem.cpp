@@ -0,0 +1,270 @@
+#include "JobSystem.h"
+
+namespace {
+    // Identifies the calling thread inside its JobSystem
+    thread_local const JobSystem* t_system = nullptr;
+    thread_local int t_index = -1;
+}
+
+// Chase-Lev work-stealing deque ("Dynamic Circular Work-Stealing Deque",
+// with the C11 memory orderings of Le et al. 2013)
+bool JobSystem::WorkQueue::push(Job* job) {
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    int64_t top = m_top.load(std::memory_order_acquire);
+    if (bottom - top >= CAPACITY) return false;
+
+    m_jobs[bottom & MASK].store(job, std::memory_order_relaxed);
+    m_bottom.store(bottom + 1, std::memory_order_release);
+    return true;
+}
+
+Job* JobSystem::WorkQueue::pop() {
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = m_top.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = m_jobs[bottom & MASK].load(std::memory_order_relaxed);
+    if (top == bottom) {
+        // Last job: race against thieves
+        if (!m_top.compare_exchange_strong(top, top + 1,
+            std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+Job* JobSystem::WorkQueue::steal() {
+    int64_t top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = m_bottom.load(std::memory_order_acquire);
+    if (top >= bottom) return nullptr;
+
+    Job* job = m_jobs[top & MASK].load(std::memory_order_relaxed);
+    if (!m_top.compare_exchange_strong(top, top + 1,
+        std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return job;
+}
+
+JobSystem::JobSystem(int workerCount)
+    : m_previousSystem(t_system),
+    m_previousIndex(t_index)
+{
+    if (workerCount < 0) {
+        int hardware = (int)std::thread::hardware_concurrency();
+        workerCount = hardware > 1 ? hardware - 1 : 0;
+    }
+
+    for (int i = 0; i <= workerCount; i++) {
+        auto state = std::make_unique<ThreadState>();
+        state->jobs.reset(new Job[JOB_POOL_SIZE]);
+        state->random = 0x9E3779B9u * (i + 1);
+        m_threads.push_back(std::move(state));
+    }
+
+    // The creating thread is index 0
+    t_system = this;
+    t_index = 0;
+
+    for (int i = 1; i <= workerCount; i++) {
+        m_workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stop.store(true);
+    }
+    m_wakeUp.notify_all();
+
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+
+    t_system = m_previousSystem;
+    t_index = m_previousIndex;
+}
+
+int JobSystem::threadIndex() const {
+    return t_system == this ? t_index : -1;
+}
+
+Job* JobSystem::allocateJob(int index) {
+    ThreadState& state = *m_threads[index];
+    // Slots usually free in order, but a long-parked continuation must
+    // not block the ring: skip busy slots, one lap at most
+    for (uint32_t i = 0; i < JOB_POOL_SIZE; i++) {
+        Job* job = &state.jobs[state.nextJob++ & (JOB_POOL_SIZE - 1)];
+        if (!job->inFlight.load(std::memory_order_acquire)) {
+            job->inFlight.store(true, std::memory_order_relaxed);
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+void JobSystem::runInline(JobFunction function, void* data, size_t begin,
+    size_t end, JobCounter* counter, JobCounter* dependency) {
+    if (dependency) wait(*dependency);
+    Job job;
+    job.function = function;
+    job.data = data;
+    job.begin = begin;
+    job.end = end;
+    job.counter = counter;
+    job.next = nullptr;
+    execute(&job);
+}
+
+void JobSystem::run(JobFunction function, void* data, size_t begin,
+    size_t end, JobCounter* counter, JobCounter* dependency) {
+    if (counter) {
+        counter->m_value.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Foreign threads have no queue to push to, and a job ring without a
+    // free slot means enough work is queued already: both run the job
+    // synchronously
+    int index = threadIndex();
+    Job* job = index >= 0 ? allocateJob(index) : nullptr;
+    if (!job) {
+        runInline(function, data, begin, end, counter, dependency);
+        return;
+    }
+
+    job->function = function;
+    job->data = data;
+    job->begin = begin;
+    job->end = end;
+    job->counter = counter;
+    job->next = nullptr;
+
+    if (dependency) {
+        std::lock_guard<std::mutex> lock(dependency->m_mutex);
+        if (dependency->m_value.load(std::memory_order_acquire) != 0) {
+            job->next = dependency->m_continuations;
+            dependency->m_continuations = job;
+            return;
+        }
+    }
+
+    submit(job);
+}
+
+void JobSystem::submit(Job* job) {
+    int index = threadIndex();
+    if (index < 0 || !m_threads[index]->queue.push(job)) {
+        // Queue full: running it here is always correct
+        execute(job);
+        return;
+    }
+
+    m_pendingJobs.fetch_add(1);
+    if (m_sleepers.load() > 0) {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_wakeUp.notify_one();
+    }
+}
+
+Job* JobSystem::findJob(int index) {
+    ThreadState& state = *m_threads[index];
+
+    Job* job = state.queue.pop();
+    if (!job) {
+        // Steal, starting from a random victim
+        uint32_t& x = state.random;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+
+        size_t count = m_threads.size();
+        for (size_t i = 0; i < count && !job; i++) {
+            size_t victim = (x + i) % count;
+            if ((int)victim != index) {
+                job = m_threads[victim]->queue.steal();
+            }
+        }
+    }
+
+    if (job) m_pendingJobs.fetch_sub(1);
+    return job;
+}
+
+void JobSystem::execute(Job* job) {
+    // Copy out, so the owner can recycle the slot while this runs
+    JobFunction function = job->function;
+    void* data = job->data;
+    size_t begin = job->begin;
+    size_t end = job->end;
+    JobCounter* counter = job->counter;
+    job->inFlight.store(false, std::memory_order_release);
+
+    function(data, begin, end);
+    if (!counter) return;
+
+    counter->m_releasing.fetch_add(1, std::memory_order_relaxed);
+    Job* continuation = nullptr;
+    if (counter->m_value.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        // Last job of the counter: release jobs that depend on it
+        std::lock_guard<std::mutex> lock(counter->m_mutex);
+        continuation = counter->m_continuations;
+        counter->m_continuations = nullptr;
+    }
+    counter->m_releasing.fetch_sub(1, std::memory_order_release);
+
+    while (continuation) {
+        Job* next = continuation->next;
+        submit(continuation);
+        continuation = next;
+    }
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    int index = threadIndex();
+    while (!counter.isDone()) {
+        Job* job = index >= 0 ? findJob(index) : nullptr;
+        if (job)
+            execute(job);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::workerLoop(int index) {
+    t_system = this;
+    t_index = index;
+
+    int idle = 0;
+    while (!m_stop.load()) {
+        Job* job = findJob(index);
+        if (job) {
+            execute(job);
+            idle = 0;
+            continue;
+        }
+
+        // Spin briefly before going to sleep
+        if (++idle < 64) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleepers.fetch_add(1);
+        m_wakeUp.wait(lock, [this] {
+            return m_pendingJobs.load() > 0 || m_stop.load();
+        });
+        m_sleepers.fetch_sub(1);
+        idle = 0;
+    }
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+struct Job;
+
+// Number of unfinished jobs attached to it. Jobs can also be queued to
+// start only when a counter drops to zero (dependencies).
+class JobCounter {
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool isDone() const {
+        return m_value.load(std::memory_order_acquire) == 0
+            && m_releasing.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<int> m_value{ 0 };
+    // Threads still touching the counter after their decrement; a
+    // waiter may destroy the counter as soon as isDone() is true
+    std::atomic<int> m_releasing{ 0 };
+    std::mutex m_mutex;                // guards m_continuations
+    Job* m_continuations = nullptr;
+};
+
+// Fixed-size job: a function over [begin, end) plus user data
+using JobFunction = void (*)(void* data, size_t begin, size_t end);
+
+struct Job {
+    JobFunction function;
+    void* data;
+    size_t begin;
+    size_t end;
+    JobCounter* counter;
+    Job* next;          // continuation list link
+    std::atomic<bool> inFlight{ false };
+};
+
+// Work-stealing job system. Every worker (and the thread that created
+// the system) owns a lock-free Chase-Lev deque: it pushes and pops at
+// the bottom, idle threads steal from the top. wait() never blocks,
+// the waiting thread runs jobs until the counter reaches zero.
+// Only the creating thread and the workers may submit jobs.
+class JobSystem {
+public:
+    // -1 = one worker per hardware thread, minus the calling thread;
+    // 0 = no workers, jobs run on the calling thread inside wait()
+    explicit JobSystem(int workerCount = -1);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Worker threads + the creating thread
+    unsigned getThreadCount() const { return (unsigned)m_threads.size(); }
+
+    void run(JobFunction function, void* data, size_t begin, size_t end,
+        JobCounter* counter, JobCounter* dependency = nullptr);
+    void wait(JobCounter& counter);
+
+    // body(begin, end) over chunks of at most `grain` elements
+    template <typename F>
+    void parallelFor(size_t begin, size_t end, size_t grain, const F& body) {
+        if (end <= begin) return;
+        grain = std::max<size_t>(grain, 1);
+        if (end - begin <= grain || getThreadCount() == 1) {
+            body(begin, end);
+            return;
+        }
+
+        JobCounter counter;
+        for (size_t b = begin; b < end; b += grain) {
+            run(&invokeRange<F>, const_cast<F*>(&body),
+                b, std::min(b + grain, end), &counter);
+        }
+        wait(counter);
+    }
+
+private:
+    // Chase-Lev deque of job pointers, fixed capacity
+    class WorkQueue {
+    public:
+        bool push(Job* job);
+        Job* pop();
+        Job* steal();
+
+    private:
+        static const int64_t CAPACITY = 4096;
+        static const int64_t MASK = CAPACITY - 1;
+
+        std::atomic<int64_t> m_top{ 0 };
+        std::atomic<int64_t> m_bottom{ 0 };
+        std::atomic<Job*> m_jobs[CAPACITY];
+    };
+
+    // Per-thread ring of Job storage. A slot is reused once its job has
+    // started; busy slots are skipped, and jobs run inline only when no
+    // slot is free.
+    struct ThreadState {
+        WorkQueue queue;
+        std::unique_ptr<Job[]> jobs;
+        uint32_t nextJob = 0;
+        uint32_t random = 0;
+    };
+
+    static const uint32_t JOB_POOL_SIZE = 4096;
+
+    std::vector<std::unique_ptr<ThreadState>> m_threads;
+    std::vector<std::thread> m_workers;
+
+    // Thread-local registration replaced by this system (nesting)
+    const JobSystem* m_previousSystem;
+    int m_previousIndex;
+
+    std::atomic<bool> m_stop{ false };
+    std::atomic<int> m_pendingJobs{ 0 };
+    std::atomic<int> m_sleepers{ 0 };
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeUp;
+
+    template <typename F>
+    static void invokeRange(void* data, size_t begin, size_t end) {
+        (*static_cast<const F*>(data))(begin, end);
+    }
+
+    int threadIndex() const;
+    Job* allocateJob(int index);
+    void runInline(JobFunction function, void* data, size_t begin,
+        size_t end, JobCounter* counter, JobCounter* dependency);
+    void submit(Job* job);
+    Job* findJob(int index);
+    void execute(Job* job);
+    void workerLoop(int index);
+};
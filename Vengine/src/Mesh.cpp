@@ -8,6 +8,16 @@ Mesh::Mesh(std::vector<Vertex> vertices,
     indices(std::move(indices)),
     textures(std::move(textures))
 {
+    if (!this->vertices.empty()) {
+        boundsMin = boundsMax = this->vertices[0].position;
+        for (const auto& v : this->vertices) {
+            boundsMin = glm::min(boundsMin, v.position);
+            boundsMax = glm::max(boundsMax, v.position);
+        }
+    }
+
+    // Uniform names are built once, not on every draw
+    buildSamplerNames();
     setupMesh();
 }
 
@@ -33,6 +43,12 @@ void Mesh::setupMesh() {
         GL_STATIC_DRAW);
 
     //  
+    setupVertexAttributes();
+
+    glBindVertexArray(0);
+}
+
+void Mesh::setupVertexAttributes() {
     // Position
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
@@ -62,19 +78,27 @@ void Mesh::setupMesh() {
         sizeof(Vertex),
         (void*)offsetof(Vertex, bitangent));
 
-    glBindVertexArray(0);
+    // Bone ids and weights; location 5 is the GpuScene draw id
+    glEnableVertexAttribArray(6);
+    glVertexAttribIPointer(6, 4, GL_UNSIGNED_BYTE,
+        sizeof(Vertex),
+        (void*)offsetof(Vertex, boneIds));
+
+    glEnableVertexAttribArray(7);
+    glVertexAttribPointer(7, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+        sizeof(Vertex),
+        (void*)offsetof(Vertex, boneWeights));
 }
 
-void Mesh::draw(Shader& shader) const {
+void Mesh::buildSamplerNames() {
     unsigned int diffuseNr = 1;
     unsigned int specularNr = 1;
     unsigned int normalNr = 1;
 
-    for (unsigned int i = 0; i < textures.size(); i++) {
-        glActiveTexture(GL_TEXTURE0 + i);
-
+    samplerNames.clear();
+    for (const auto& texture : textures) {
         std::string number;
-        std::string name = textures[i].type;
+        const std::string& name = texture.type;
 
         if (name == "texture_diffuse")
             number = std::to_string(diffuseNr++);
@@ -83,9 +107,20 @@ void Mesh::draw(Shader& shader) const {
         else if (name == "texture_normal")
             number = std::to_string(normalNr++);
 
-        shader.setInt(("material." + name + number).c_str(), i);
+        samplerNames.push_back("material." + name + number);
+    }
+}
+
+void Mesh::bindTextures(Shader& shader) const {
+    for (unsigned int i = 0; i < textures.size(); i++) {
+        glActiveTexture(GL_TEXTURE0 + i);
+        shader.setInt(samplerNames[i], i);
         glBindTexture(GL_TEXTURE_2D, textures[i].id);
     }
+}
+
+void Mesh::draw(Shader& shader) const {
+    bindTextures(shader);
 
     //  
     glBindVertexArray(VAO);
@@ -97,6 +132,20 @@ void Mesh::draw(Shader& shader) const {
     glActiveTexture(GL_TEXTURE0);
 }
 
+void Mesh::drawClusters(Shader& shader,
+    const MeshletDrawList& clusters) const {
+    if (clusters.drawCount == 0) return;
+
+    bindTextures(shader);
+
+    glBindVertexArray(VAO);
+    glMultiDrawElements(GL_TRIANGLES, clusters.counts, GL_UNSIGNED_INT,
+        clusters.offsets, clusters.drawCount);
+    glBindVertexArray(0);
+
+    glActiveTexture(GL_TEXTURE0);
+}
+
 void Mesh::cleanup() {
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
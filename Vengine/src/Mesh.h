@@ -1,6 +1,9 @@
 #pragma once
+#include "Bvh.h"
+#include "Meshlet.h"
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <cstdint>
 #include <vector>
 #include <string>
 
@@ -10,6 +13,10 @@ struct Vertex {
     glm::vec2 texCoords;
     glm::vec3 tangent;
     glm::vec3 bitangent;
+    // Skinning palette indices and weights (unorm8 summing to 255);
+    // all-zero weights mark a rigid vertex
+    uint8_t boneIds[4] = { 0, 0, 0, 0 };
+    uint8_t boneWeights[4] = { 0, 0, 0, 0 };
 };
 
 struct Texture {
@@ -24,15 +31,33 @@ public:
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
 
+    // Local-space bounds, used for culling
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+
+    // Triangle BVH for picking and spatial queries
+    MeshBvh bvh;
+    // Clusters over contiguous ranges of `indices`
+    std::vector<Meshlet> meshlets;
+
     Mesh(std::vector<Vertex> vertices,
         std::vector<unsigned int> indices,
         std::vector<Texture> textures);
 
     void draw(class Shader& shader) const;
+    // Draws only the given index ranges, in one glMultiDrawElements
+    void drawClusters(class Shader& shader,
+        const MeshletDrawList& clusters) const;
     void cleanup();
 
+    // Vertex layout shared by every VAO built from Vertex arrays
+    static void setupVertexAttributes();
+
 private:
     GLuint VAO, VBO, EBO;
+    std::vector<std::string> samplerNames;
 
     void setupMesh();
+    void bindTextures(class Shader& shader) const;
+    void buildSamplerNames();
 };
\ No newline at end of file
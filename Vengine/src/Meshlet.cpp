@@ -0,0 +1,277 @@
+#include "Meshlet.h"
+#include "Mesh.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Score penalty for a triangle facing away from the meshlet normal
+    const float CONE_WEIGHT = 2.0f;
+    // Below this the cone is too wide to ever reject the meshlet
+    const float MIN_CONE_DOT = 0.1f;
+
+    uint32_t expandBits(uint32_t v) {
+        v = (v * 0x00010001u) & 0xFF0000FFu;
+        v = (v * 0x00000101u) & 0x0F00F00Fu;
+        v = (v * 0x00000011u) & 0xC30C30C3u;
+        v = (v * 0x00000005u) & 0x49249249u;
+        return v;
+    }
+
+    // 30-bit Morton code of a point normalized to [0, 1]
+    uint32_t mortonCode(const glm::vec3& p) {
+        glm::vec3 q = glm::clamp(p * 1024.0f, glm::vec3(0.0f),
+            glm::vec3(1023.0f));
+        return expandBits((uint32_t)q.x) << 2
+            | expandBits((uint32_t)q.y) << 1
+            | expandBits((uint32_t)q.z);
+    }
+
+    Meshlet finishMeshlet(const std::vector<Vertex>& vertices,
+        const std::vector<unsigned int>& meshletIndices,
+        const std::vector<glm::vec3>& normals,
+        const std::vector<uint32_t>& triangles, uint32_t vertexCount) {
+        Meshlet meshlet;
+        meshlet.triangleCount = static_cast<uint32_t>(triangles.size());
+        meshlet.vertexCount = vertexCount;
+        meshlet.firstIndex = 0;
+
+        glm::vec3 boundsMin = vertices[meshletIndices[0]].position;
+        glm::vec3 boundsMax = boundsMin;
+        for (unsigned int index : meshletIndices) {
+            boundsMin = glm::min(boundsMin, vertices[index].position);
+            boundsMax = glm::max(boundsMax, vertices[index].position);
+        }
+        meshlet.center = (boundsMin + boundsMax) * 0.5f;
+        meshlet.radius = 0.0f;
+        for (unsigned int index : meshletIndices) {
+            meshlet.radius = std::max(meshlet.radius,
+                glm::length(vertices[index].position - meshlet.center));
+        }
+
+        // Normal cone (meshoptimizer): axis = average normal, cutoff from
+        // the widest angle between the axis and a triangle normal
+        glm::vec3 axis(0.0f);
+        for (uint32_t t : triangles) axis += normals[t];
+        float length = glm::length(axis);
+        meshlet.coneAxis = length > 0.0f ? axis / length
+            : glm::vec3(0.0f, 0.0f, 1.0f);
+        meshlet.coneCutoff = 1.0f;
+
+        if (length > 0.0f) {
+            float minDot = 1.0f;
+            for (uint32_t t : triangles) {
+                if (normals[t] == glm::vec3(0.0f)) continue;
+                minDot = std::min(minDot, glm::dot(normals[t],
+                    meshlet.coneAxis));
+            }
+            if (minDot > MIN_CONE_DOT) {
+                meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+            }
+        }
+        return meshlet;
+    }
+}
+
+std::vector<Meshlet> buildMeshlets(const std::vector<Vertex>& vertices,
+    std::vector<unsigned int>& indices) {
+    std::vector<Meshlet> meshlets;
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return meshlets;
+
+    // Unit face normals and centroids
+    std::vector<glm::vec3> normals(triangleCount);
+    std::vector<glm::vec3> centroids(triangleCount);
+    glm::vec3 boundsMin = vertices[indices[0]].position;
+    glm::vec3 boundsMax = boundsMin;
+    for (size_t t = 0; t < triangleCount; t++) {
+        const glm::vec3& a = vertices[indices[t * 3 + 0]].position;
+        const glm::vec3& b = vertices[indices[t * 3 + 1]].position;
+        const glm::vec3& c = vertices[indices[t * 3 + 2]].position;
+        glm::vec3 n = glm::cross(b - a, c - a);
+        float length = glm::length(n);
+        normals[t] = length > 0.0f ? n / length : glm::vec3(0.0f);
+        centroids[t] = (a + b + c) / 3.0f;
+        boundsMin = glm::min(boundsMin, centroids[t]);
+        boundsMax = glm::max(boundsMax, centroids[t]);
+    }
+
+    // Vertex -> triangles adjacency (CSR)
+    std::vector<uint32_t> adjacencyOffset(vertices.size() + 1, 0);
+    for (unsigned int index : indices) adjacencyOffset[index + 1]++;
+    for (size_t v = 0; v < vertices.size(); v++) {
+        adjacencyOffset[v + 1] += adjacencyOffset[v];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyOffset.begin(),
+        adjacencyOffset.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    // New meshlets start at the next free triangle along a Morton curve,
+    // so disconnected pieces are still visited in spatial order
+    std::vector<uint32_t> seeds(triangleCount);
+    std::vector<uint32_t> codes(triangleCount);
+    glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+    for (size_t t = 0; t < triangleCount; t++) {
+        seeds[t] = static_cast<uint32_t>(t);
+        codes[t] = mortonCode((centroids[t] - boundsMin) / extent);
+    }
+    std::sort(seeds.begin(), seeds.end(), [&](uint32_t a, uint32_t b) {
+        return codes[a] < codes[b];
+    });
+    size_t nextSeed = 0;
+
+    std::vector<bool> assigned(triangleCount, false);
+    // Meshlet that last used each vertex; marks membership
+    std::vector<int> vertexMeshlet(vertices.size(), -1);
+
+    std::vector<unsigned int> reordered;
+    reordered.reserve(indices.size());
+    std::vector<uint32_t> triangles;
+    std::vector<uint32_t> meshletVertices;
+    std::vector<unsigned int> meshletIndices;
+    glm::vec3 normalSum(0.0f);
+
+    auto newVertexCount = [&](uint32_t t) {
+        int meshletIndex = static_cast<int>(meshlets.size());
+        uint32_t count = 0;
+        for (int k = 0; k < 3; k++) {
+            count += vertexMeshlet[indices[t * 3 + k]] != meshletIndex;
+        }
+        return count;
+    };
+
+    auto flush = [&]() {
+        Meshlet meshlet = finishMeshlet(vertices, meshletIndices, normals,
+            triangles, static_cast<uint32_t>(meshletVertices.size()));
+        meshlet.firstIndex = static_cast<uint32_t>(reordered.size());
+        reordered.insert(reordered.end(),
+            meshletIndices.begin(), meshletIndices.end());
+        meshlets.push_back(meshlet);
+
+        triangles.clear();
+        meshletVertices.clear();
+        meshletIndices.clear();
+        normalSum = glm::vec3(0.0f);
+    };
+
+    while (true) {
+        int64_t best = -1;
+
+        if (!triangles.empty()) {
+            // Cheapest unassigned neighbour of the current meshlet
+            float bestScore = 1e30f;
+            float normalLength = glm::length(normalSum);
+            glm::vec3 axis = normalLength > 0.0f ? normalSum / normalLength
+                : glm::vec3(0.0f);
+
+            for (uint32_t v : meshletVertices) {
+                for (uint32_t a = adjacencyOffset[v];
+                    a < adjacencyOffset[v + 1]; a++) {
+                    uint32_t t = adjacency[a];
+                    if (assigned[t]) continue;
+
+                    uint32_t added = newVertexCount(t);
+                    if (meshletVertices.size() + added
+                        > MESHLET_MAX_VERTICES) continue;
+
+                    float score = added + CONE_WEIGHT
+                        * (1.0f - glm::dot(normals[t], axis));
+                    if (score < bestScore) {
+                        bestScore = score;
+                        best = t;
+                    }
+                }
+            }
+
+            if (best < 0) {
+                flush();
+                continue;
+            }
+        }
+        else {
+            while (nextSeed < triangleCount && assigned[seeds[nextSeed]]) {
+                nextSeed++;
+            }
+            if (nextSeed == triangleCount) break;
+            best = seeds[nextSeed];
+        }
+
+        uint32_t t = static_cast<uint32_t>(best);
+        int meshletIndex = static_cast<int>(meshlets.size());
+        assigned[t] = true;
+        triangles.push_back(t);
+        normalSum += normals[t];
+        for (int k = 0; k < 3; k++) {
+            unsigned int index = indices[t * 3 + k];
+            if (vertexMeshlet[index] != meshletIndex) {
+                vertexMeshlet[index] = meshletIndex;
+                meshletVertices.push_back(index);
+            }
+            meshletIndices.push_back(index);
+        }
+
+        if (triangles.size() == MESHLET_MAX_TRIANGLES
+            || meshletVertices.size() == MESHLET_MAX_VERTICES) {
+            flush();
+        }
+    }
+
+    if (!triangles.empty()) flush();
+
+    indices.swap(reordered);
+    return meshlets;
+}
+
+GLsizei cullMeshlets(const std::vector<Meshlet>& meshlets,
+    const Frustum& frustum, const glm::vec3& camera,
+    GLsizei* counts, const void** offsets, ClusterStats& stats) {
+    GLsizei drawCount = 0;
+    uint32_t rangeEnd = 0;
+
+    for (const auto& meshlet : meshlets) {
+        stats.clusters++;
+        stats.triangles += meshlet.triangleCount;
+
+        if (!frustum.intersectsSphere(meshlet.center, meshlet.radius)) {
+            stats.frustumCulled++;
+            stats.trianglesCulled += meshlet.triangleCount;
+            continue;
+        }
+
+        // Every triangle faces away from any viewpoint at the camera
+        glm::vec3 toCenter = meshlet.center - camera;
+        if (glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff
+            * glm::length(toCenter) + meshlet.radius) {
+            stats.backfaceCulled++;
+            stats.trianglesCulled += meshlet.triangleCount;
+            continue;
+        }
+
+        GLsizei count = static_cast<GLsizei>(meshlet.triangleCount * 3);
+        if (drawCount > 0 && rangeEnd == meshlet.firstIndex) {
+            counts[drawCount - 1] += count;
+        }
+        else {
+            counts[drawCount] = count;
+            offsets[drawCount] = reinterpret_cast<const void*>(
+                meshlet.firstIndex * sizeof(unsigned int));
+            drawCount++;
+        }
+        rangeEnd = meshlet.firstIndex + meshlet.triangleCount * 3;
+    }
+    return drawCount;
+}
+
+Frustum localFrustum(const Frustum& frustum, const glm::mat4& toWorld) {
+    // Planes are covectors: local = transpose(M) * plane
+    Frustum local;
+    for (int i = 0; i < 6; i++) {
+        const glm::vec4& p = frustum.planes[i];
+        glm::vec4 q(glm::dot(p, toWorld[0]), glm::dot(p, toWorld[1]),
+            glm::dot(p, toWorld[2]), glm::dot(p, toWorld[3]));
+        local.planes[i] = q / glm::length(glm::vec3(q));
+    }
+    return local;
+}
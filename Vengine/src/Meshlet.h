@@ -0,0 +1,62 @@
+#pragma once
+#include "Frustum.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+struct Vertex;
+
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// Cluster of neighbouring triangles; its triangles are contiguous in the
+// mesh index buffer, so a meshlet is drawn as one index range
+struct Meshlet {
+    glm::vec3 center;         // bounding sphere, mesh space
+    float radius;
+    glm::vec3 coneAxis;       // average facing direction
+    float coneCutoff;         // sin of the cone half-angle, 1 = never culled
+    uint32_t firstIndex;
+    uint32_t triangleCount;
+    uint32_t vertexCount;
+};
+
+// Index ranges of one mesh for glMultiDrawElements
+struct MeshletDrawList {
+    const GLsizei* counts;
+    const void* const* offsets;
+    GLsizei drawCount;
+};
+
+struct ClusterStats {
+    size_t clusters = 0;
+    size_t frustumCulled = 0;
+    size_t backfaceCulled = 0;
+    size_t triangles = 0;
+    size_t trianglesCulled = 0;
+
+    void add(const ClusterStats& other) {
+        clusters += other.clusters;
+        frustumCulled += other.frustumCulled;
+        backfaceCulled += other.backfaceCulled;
+        triangles += other.triangles;
+        trianglesCulled += other.trianglesCulled;
+    }
+};
+
+// Greedy clustering: grows each meshlet through shared vertices,
+// preferring triangles that add few vertices and face the same way.
+// Reorders `indices` so that every meshlet is one contiguous range.
+std::vector<Meshlet> buildMeshlets(const std::vector<Vertex>& vertices,
+    std::vector<unsigned int>& indices);
+
+// Writes the index ranges of meshlets that are inside the frustum and
+// not entirely back-facing; frustum and camera are in mesh space.
+// Adjacent ranges are merged. Returns the number of ranges written.
+GLsizei cullMeshlets(const std::vector<Meshlet>& meshlets,
+    const Frustum& frustum, const glm::vec3& camera,
+    GLsizei* counts, const void** offsets, ClusterStats& stats);
+
+// Frustum of a world-space frustum in the space of `toWorld`
+Frustum localFrustum(const Frustum& frustum, const glm::mat4& toWorld);
@@ -1,16 +1,86 @@
 #include "Model.h"
+#include "JobSystem.h"
+#include <assimp/DefaultIOSystem.h>
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-Model::Model(const std::string& path) {
-    loadModel(path);
+namespace {
+    // Records every file Assimp opens, for hot-reload dependencies
+    class RecordingIOSystem : public Assimp::DefaultIOSystem {
+    public:
+        explicit RecordingIOSystem(std::vector<std::string>& files)
+            : m_files(files) {}
+
+        Assimp::IOStream* Open(const char* file,
+            const char* mode = "rb") override {
+            Assimp::IOStream* stream = DefaultIOSystem::Open(file, mode);
+            if (stream) m_files.push_back(file);
+            return stream;
+        }
+
+    private:
+        std::vector<std::string>& m_files;
+    };
+
+    // Assimp matrices are row-major
+    glm::mat4 toGlm(const aiMatrix4x4& m) {
+        return glm::mat4(
+            glm::vec4(m.a1, m.b1, m.c1, m.d1),
+            glm::vec4(m.a2, m.b2, m.c2, m.d2),
+            glm::vec4(m.a3, m.b3, m.c3, m.d3),
+            glm::vec4(m.a4, m.b4, m.c4, m.d4));
+    }
+
+    // Keeps the four largest influences of a vertex
+    void addBoneWeight(float* weights, Vertex& vertex, uint32_t bone,
+        float weight) {
+        int smallest = 0;
+        for (int i = 1; i < 4; i++) {
+            if (weights[i] < weights[smallest]) smallest = i;
+        }
+        if (weight <= weights[smallest]) return;
+        weights[smallest] = weight;
+        vertex.boneIds[smallest] = static_cast<uint8_t>(bone);
+    }
+
+    // Normalized unorm8 weights; rounding error goes to the largest one
+    void packBoneWeights(const float* weights, Vertex& vertex) {
+        float sum = weights[0] + weights[1] + weights[2] + weights[3];
+        if (sum <= 0.0f) return;
+
+        int total = 0, largest = 0;
+        for (int i = 0; i < 4; i++) {
+            int value = static_cast<int>(std::lround(weights[i] / sum * 255));
+            vertex.boneWeights[i] = static_cast<uint8_t>(value);
+            total += value;
+            if (weights[i] > weights[largest]) largest = i;
+        }
+        vertex.boneWeights[largest] = static_cast<uint8_t>(
+            vertex.boneWeights[largest] + 255 - total);
+    }
+}
+
+Model::Model(const std::string& path, JobSystem* jobs) {
+    ModelData data = import(path, jobs);
+    upload(data);
+}
+
+Model::Model(ModelData data) {
+    upload(data);
 }
 
-void Model::loadModel(const std::string& path) {
+ModelData Model::import(const std::string& path, JobSystem* jobs,
+    const std::unordered_set<std::string>* knownImages) {
+    ModelData data;
+    data.path = path;
+
     Assimp::Importer importer;
+    importer.SetIOHandler(new RecordingIOSystem(data.sourceFiles));
 
     const aiScene* scene = importer.ReadFile(path,
         aiProcess_Triangulate |           // 
@@ -18,45 +88,206 @@ void Model::loadModel(const std::string& path) {
         aiProcess_FlipUVs |               //  UV
         aiProcess_CalcTangentSpace |      //   normal mapping
         aiProcess_JoinIdenticalVertices | //  
-        aiProcess_OptimizeMeshes          //  
+        aiProcess_OptimizeMeshes |        //  
+        aiProcess_LimitBoneWeights        // At most 4 bones per vertex
     );
 
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE
         || !scene->mRootNode) {
         std::cerr << "Assimp Error: " << importer.GetErrorString()
             << std::endl;
-        return;
+        return data;
     }
 
     //    
-    directory = path.substr(0, path.find_last_of('/'));
+    std::string directory = path.substr(0, path.find_last_of('/'));
     if (directory == path) {
         directory = path.substr(0, path.find_last_of('\\'));
     }
 
-    std::cout << "Loading model: " << path << std::endl;
-    std::cout << "Meshes count: " << scene->mNumMeshes << std::endl;
+    std::vector<aiMesh*> sceneMeshes;
+    processNode(scene->mRootNode, scene, sceneMeshes);
+
+    // The bone palette is shared by all meshes, so it is built first
+    std::unordered_map<std::string, uint32_t> boneIndex;
+    buildSkeleton(scene, sceneMeshes, data.skeleton, boneIndex);
+
+    // Meshes are independent: convert them in parallel
+    data.meshes.resize(sceneMeshes.size());
+    auto convertMeshes = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            data.meshes[i] = processMesh(sceneMeshes[i], scene, directory,
+                boneIndex);
+        }
+    };
+    if (jobs)
+        jobs->parallelFor(0, sceneMeshes.size(), 1, convertMeshes);
+    else
+        convertMeshes(0, sceneMeshes.size());
+
+    // Each texture is decoded once, also in parallel
+    std::unordered_map<std::string, size_t> imageIndex;
+    for (const auto& mesh : data.meshes) {
+        for (const auto& texture : mesh.textures) {
+            if (imageIndex.count(texture.path)) continue;
+            imageIndex[texture.path] = data.images.size();
+            data.images.push_back(ImageData());
+            data.images.back().path = texture.path;
+        }
+    }
+
+    auto decodeImages = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if (knownImages && knownImages->count(data.images[i].path))
+                continue;
+            data.images[i] = loadImage(data.images[i].path);
+        }
+    };
+    if (jobs)
+        jobs->parallelFor(0, data.images.size(), 1, decodeImages);
+    else
+        decodeImages(0, data.images.size());
+
+    // Clips are resampled and compressed as jobs too
+    if (data.skeleton.getJointCount() > 0) {
+        data.clips.resize(scene->mNumAnimations);
+        auto convertClips = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                data.clips[i] = processAnimation(scene->mAnimations[i],
+                    data.skeleton);
+            }
+        };
+        if (jobs)
+            jobs->parallelFor(0, data.clips.size(), 1, convertClips);
+        else
+            convertClips(0, data.clips.size());
+    }
+
+    return data;
+}
+
+void Model::buildSkeleton(const aiScene* scene,
+    const std::vector<aiMesh*>& meshes, Skeleton& skeleton,
+    std::unordered_map<std::string, uint32_t>& boneIndex) {
+    bool hasBones = false;
+    for (const aiMesh* mesh : meshes) hasBones |= mesh->mNumBones > 0;
+    if (!hasBones && scene->mNumAnimations == 0) return;
+
+    // Every node is a joint: animations may target any of them.
+    // Depth-first order keeps parents before children.
+    std::vector<std::pair<const aiNode*, int>> stack;
+    stack.push_back(std::make_pair(scene->mRootNode, -1));
+    while (!stack.empty()) {
+        const aiNode* node = stack.back().first;
+        int parent = stack.back().second;
+        stack.pop_back();
+
+        int joint = static_cast<int>(skeleton.parents.size());
+        skeleton.jointNames.push_back(node->mName.C_Str());
+        skeleton.parents.push_back(parent);
+
+        aiVector3D scaling, position;
+        aiQuaternion rotation;
+        node->mTransformation.Decompose(scaling, rotation, position);
+        skeleton.bindPose.translations.push_back(
+            glm::vec4(position.x, position.y, position.z, 0.0f));
+        skeleton.bindPose.rotations.push_back(
+            glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w));
+        skeleton.bindPose.scales.push_back(
+            glm::vec4(scaling.x, scaling.y, scaling.z, 0.0f));
+
+        for (unsigned int i = node->mNumChildren; i-- > 0;) {
+            stack.push_back(std::make_pair(node->mChildren[i], joint));
+        }
+    }
+    skeleton.rootTransform = glm::inverse(
+        toGlm(scene->mRootNode->mTransformation));
+
+    for (const aiMesh* mesh : meshes) {
+        for (unsigned int b = 0; b < mesh->mNumBones; b++) {
+            const aiBone* bone = mesh->mBones[b];
+            std::string name = bone->mName.C_Str();
+            if (boneIndex.count(name)) continue;
+
+            int joint = skeleton.findJoint(name);
+            if (joint < 0) {
+                std::cerr << "  Bone without node: " << name << std::endl;
+                continue;
+            }
+            if (skeleton.boneJoints.size() == MAX_BONES) {
+                std::cerr << "  More than " << MAX_BONES
+                    << " bones, ignoring " << name << std::endl;
+                continue;
+            }
+            boneIndex[name] = static_cast<uint32_t>(
+                skeleton.boneJoints.size());
+            skeleton.boneJoints.push_back(static_cast<uint32_t>(joint));
+            skeleton.boneOffsets.push_back(toGlm(bone->mOffsetMatrix));
+        }
+    }
+}
+
+AnimationClip Model::processAnimation(const aiAnimation* animation,
+    const Skeleton& skeleton) {
+    double ticksPerSecond = animation->mTicksPerSecond > 0.0
+        ? animation->mTicksPerSecond : 25.0;
+    std::vector<JointKeys> keys(skeleton.getJointCount());
+
+    for (unsigned int c = 0; c < animation->mNumChannels; c++) {
+        const aiNodeAnim* channel = animation->mChannels[c];
+        int joint = skeleton.findJoint(channel->mNodeName.C_Str());
+        if (joint < 0) continue;
+        JointKeys& jointKeys = keys[joint];
+
+        for (unsigned int k = 0; k < channel->mNumPositionKeys; k++) {
+            const aiVectorKey& key = channel->mPositionKeys[k];
+            jointKeys.translationTimes.push_back(
+                static_cast<float>(key.mTime / ticksPerSecond));
+            jointKeys.translations.push_back(
+                glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+        }
+        for (unsigned int k = 0; k < channel->mNumRotationKeys; k++) {
+            const aiQuatKey& key = channel->mRotationKeys[k];
+            jointKeys.rotationTimes.push_back(
+                static_cast<float>(key.mTime / ticksPerSecond));
+            jointKeys.rotations.push_back(glm::vec4(key.mValue.x,
+                key.mValue.y, key.mValue.z, key.mValue.w));
+        }
+        for (unsigned int k = 0; k < channel->mNumScalingKeys; k++) {
+            const aiVectorKey& key = channel->mScalingKeys[k];
+            jointKeys.scaleTimes.push_back(
+                static_cast<float>(key.mTime / ticksPerSecond));
+            jointKeys.scales.push_back(
+                glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+        }
+    }
 
-    processNode(scene->mRootNode, scene);
+    return AnimationClip::build(animation->mName.C_Str(),
+        static_cast<float>(animation->mDuration / ticksPerSecond),
+        skeleton, keys);
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene) {
+void Model::processNode(aiNode* node, const aiScene* scene,
+    std::vector<aiMesh*>& out) {
     //    
     for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        out.push_back(scene->mMeshes[node->mMeshes[i]]);
     }
 
     //    
     for (unsigned int i = 0; i < node->mNumChildren; i++) {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, out);
     }
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-    std::vector<Texture> textures;
+MeshData Model::processMesh(aiMesh* mesh, const aiScene* scene,
+    const std::string& directory,
+    const std::unordered_map<std::string, uint32_t>& boneIndex) {
+    MeshData data;
+    std::vector<Vertex>& vertices = data.vertices;
+    std::vector<unsigned int>& indices = data.indices;
+    vertices.reserve(mesh->mNumVertices);
+    indices.reserve(mesh->mNumFaces * 3);
 
     //  
     for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
@@ -116,85 +347,177 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
         }
     }
 
+    // Bone influences, indexed by palette slot
+    if (mesh->mNumBones > 0) {
+        std::vector<float> weights(vertices.size() * 4, 0.0f);
+        for (unsigned int b = 0; b < mesh->mNumBones; b++) {
+            const aiBone* bone = mesh->mBones[b];
+            auto it = boneIndex.find(bone->mName.C_Str());
+            if (it == boneIndex.end()) continue;
+
+            for (unsigned int w = 0; w < bone->mNumWeights; w++) {
+                const aiVertexWeight& weight = bone->mWeights[w];
+                addBoneWeight(&weights[weight.mVertexId * 4],
+                    vertices[weight.mVertexId], it->second, weight.mWeight);
+            }
+        }
+        for (size_t v = 0; v < vertices.size(); v++) {
+            packBoneWeights(&weights[v * 4], vertices[v]);
+        }
+    }
+
+    // Meshlets reorder the indices, so they are built before the BVH
+    data.meshlets = buildMeshlets(vertices, indices);
+    data.bvh.build(vertices, indices);
+
     //  
     if (mesh->mMaterialIndex >= 0) {
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 
         // Diffuse maps
-        auto diffuseMaps = loadMaterialTextures(material,
-            aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(),
-            diffuseMaps.begin(), diffuseMaps.end());
+        collectMaterialTextures(material, aiTextureType_DIFFUSE,
+            "texture_diffuse", directory, data.textures);
 
         // Specular maps
-        auto specularMaps = loadMaterialTextures(material,
-            aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(),
-            specularMaps.begin(), specularMaps.end());
+        collectMaterialTextures(material, aiTextureType_SPECULAR,
+            "texture_specular", directory, data.textures);
 
         // Normal maps
-        auto normalMaps = loadMaterialTextures(material,
-            aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(),
-            normalMaps.begin(), normalMaps.end());
+        collectMaterialTextures(material, aiTextureType_HEIGHT,
+            "texture_normal", directory, data.textures);
     }
 
-    std::cout << "  Mesh loaded: " << vertices.size() << " vertices, "
-        << indices.size() / 3 << " triangles" << std::endl;
-
-    return Mesh(vertices, indices, textures);
+    return data;
 }
 
-//
-std::vector<Texture> Model::loadMaterialTextures(
+// Texture ids stay 0 until upload()
+void Model::collectMaterialTextures(
     aiMaterial* mat,
     aiTextureType type,
-    const std::string& typeName)
+    const std::string& typeName,
+    const std::string& directory,
+    std::vector<Texture>& textures)
 {
-    std::vector<Texture> textures;
-
     for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
         aiString str;
         mat->GetTexture(type, i, &str);
-        std::string texPath = directory + "/" + str.C_Str();
 
+        Texture texture;
+        texture.id = 0;
+        texture.type = typeName;
+        texture.path = directory + "/" + str.C_Str();
+        textures.push_back(texture);
+    }
+}
+
+ImageData Model::loadImage(const std::string& path) {
+    ImageData image;
+    image.path = path;
+
+    unsigned char* pixels = stbi_load(path.c_str(),
+        &image.width, &image.height, &image.components, 0);
+    if (pixels) {
+        image.pixels.reset(pixels, stbi_image_free);
+    }
+    return image;
+}
+
+void Model::upload(ModelData& data) {
+    path = data.path;
+    sourceFiles = data.sourceFiles;
+    if (data.meshes.empty()) return;
+
+    std::cout << "Loading model: " << data.path << std::endl;
+    std::cout << "Meshes count: " << data.meshes.size() << std::endl;
+
+    for (const auto& image : data.images) {
+        // Skipped by import: the texture is already loaded
+        if (!image.pixels && loadedTextures.count(image.path)) continue;
+
+        Texture texture;
+        texture.id = uploadTexture(image);
+        texture.path = image.path;
+        loadedTextures[image.path] = texture;
+    }
+
+    meshes.reserve(data.meshes.size());
+    for (auto& mesh : data.meshes) {
         // ,    
-        if (loadedTextures.find(texPath) != loadedTextures.end()) {
-            textures.push_back(loadedTextures[texPath]);
+        for (auto& texture : mesh.textures) {
+            texture.id = loadedTextures[texture.path].id;
         }
-        else {
-            Texture texture;
-            texture.id = loadTextureFromFile(texPath);
-            texture.type = typeName;
-            texture.path = texPath;
-            textures.push_back(texture);
-            loadedTextures[texPath] = texture;
+
+        std::cout << "  Mesh loaded: " << mesh.vertices.size()
+            << " vertices, " << mesh.indices.size() / 3 << " triangles, "
+            << mesh.meshlets.size() << " meshlets" << std::endl;
+
+        meshes.push_back(Mesh(std::move(mesh.vertices),
+            std::move(mesh.indices), std::move(mesh.textures)));
+        meshes.back().meshlets = std::move(mesh.meshlets);
+        meshes.back().bvh = std::move(mesh.bvh);
+    }
+
+    skeleton = std::move(data.skeleton);
+    clips = std::move(data.clips);
+    if (skeleton.getJointCount() > 0) {
+        std::cout << "  Skeleton: " << skeleton.getJointCount()
+            << " joints, " << skeleton.boneJoints.size() << " bones, "
+            << clips.size() << " clips" << std::endl;
+    }
+}
+
+bool Model::reload(ModelData data) {
+    if (data.meshes.empty()) return false;
+
+    for (auto& mesh : meshes) {
+        mesh.cleanup();
+    }
+    meshes.clear();
+
+    // Textures the new version no longer uses are released
+    std::unordered_set<std::string> used;
+    for (const auto& image : data.images) used.insert(image.path);
+    for (auto it = loadedTextures.begin(); it != loadedTextures.end();) {
+        if (used.count(it->first)) {
+            ++it;
+            continue;
         }
+        glDeleteTextures(1, &it->second.id);
+        it = loadedTextures.erase(it);
     }
 
-    return textures;
+    upload(data);
+    return true;
 }
 
-GLuint Model::loadTextureFromFile(const std::string& path) {
-    GLuint textureID;
-    glGenTextures(1, &textureID);
+bool Model::reloadTexture(const ImageData& image) {
+    auto it = loadedTextures.find(image.path);
+    if (it == loadedTextures.end() || !image.pixels) return false;
+    uploadTexture(image, it->second.id);
+    return true;
+}
+
+std::vector<std::string> Model::getTexturePaths() const {
+    std::vector<std::string> paths;
+    for (const auto& entry : loadedTextures) paths.push_back(entry.first);
+    return paths;
+}
 
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(path.c_str(),
-        &width, &height, &nrComponents, 0);
+GLuint Model::uploadTexture(const ImageData& image, GLuint textureID) {
+    if (!textureID) glGenTextures(1, &textureID);
 
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
+    if (image.pixels) {
+        GLenum format = GL_RGBA;
+        if (image.components == 1)
             format = GL_RED;
-        else if (nrComponents == 3)
+        else if (image.components == 3)
             format = GL_RGB;
-        else if (nrComponents == 4)
+        else if (image.components == 4)
             format = GL_RGBA;
 
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height,
-            0, format, GL_UNSIGNED_BYTE, data);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height,
+            0, format, GL_UNSIGNED_BYTE, image.pixels.get());
         glGenerateMipmap(GL_TEXTURE_2D);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -203,24 +526,41 @@ GLuint Model::loadTextureFromFile(const std::string& path) {
             GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-        std::cout << "  Texture loaded: " << path << std::endl;
+        std::cout << "  Texture loaded: " << image.path << std::endl;
     }
     else {
-        std::cerr << "  Failed to load texture: " << path << std::endl;
+        std::cerr << "  Failed to load texture: " << image.path << std::endl;
     }
 
-    stbi_image_free(data);
     return textureID;
 }
 
 void Model::draw(Shader& shader) {
-    shader.setMat4("model", getModelMatrix());
+    glm::mat4 modelMatrix = getModelMatrix();
+    draw(shader, modelMatrix,
+        glm::transpose(glm::inverse(glm::mat3(modelMatrix))));
+}
+
+void Model::draw(Shader& shader, const glm::mat4& modelMatrix,
+    const glm::mat3& normalMatrix) {
+    shader.setMat4("model", modelMatrix);
+    shader.setMat3("normalMatrix", normalMatrix);
 
     for (auto& mesh : meshes) {
         mesh.draw(shader);
     }
 }
 
+void Model::drawClusters(Shader& shader, const glm::mat4& modelMatrix,
+    const glm::mat3& normalMatrix, const MeshletDrawList* clusters) {
+    shader.setMat4("model", modelMatrix);
+    shader.setMat3("normalMatrix", normalMatrix);
+
+    for (size_t i = 0; i < meshes.size(); i++) {
+        meshes[i].drawClusters(shader, clusters[i]);
+    }
+}
+
 glm::mat4 Model::getModelMatrix() const {
     glm::mat4 model = glm::mat4(1.0f);
     model = glm::translate(model, position);
@@ -1,17 +1,74 @@
 #pragma once
+#include "Animation.h"
 #include "Mesh.h"
 #include "Shader.h"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <memory>
 #include <vector>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+
+class JobSystem;
+
+// Decoded image; pixels are freed with stbi_image_free
+struct ImageData {
+    std::string path;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    std::shared_ptr<unsigned char> pixels;
+};
+
+// Mesh before GL upload (texture ids are still 0)
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<Texture> textures;
+    std::vector<Meshlet> meshlets;
+    MeshBvh bvh;
+};
+
+// Result of Model::import: everything except GL objects
+struct ModelData {
+    std::string path;
+    std::vector<MeshData> meshes;
+    std::vector<ImageData> images;
+    // Files Assimp read: the model and any material or buffer files
+    std::vector<std::string> sourceFiles;
+    // Empty unless the scene has bones or animations
+    Skeleton skeleton;
+    std::vector<AnimationClip> clips;
+};
 
 class Model {
 public:
-    Model(const std::string& path);
+    Model(const std::string& path, JobSystem* jobs = nullptr);
+    explicit Model(ModelData data);
+
+    // Assimp import + image decoding without GL calls, so it can run
+    // off the GL thread; meshes and images are processed as jobs.
+    // Images in knownImages are not decoded (pixels stay null).
+    static ModelData import(const std::string& path,
+        JobSystem* jobs = nullptr,
+        const std::unordered_set<std::string>* knownImages = nullptr);
+    static ImageData loadImage(const std::string& path);
+
+    // Hot reload, GL thread only. Meshes are rebuilt; textures whose
+    // image was skipped by import keep their GL objects. Returns false
+    // (and keeps the old data) when the import failed.
+    bool reload(ModelData data);
+    // Re-uploads into the existing texture object of image.path
+    bool reloadTexture(const ImageData& image);
+
     void draw(Shader& shader);
+    void draw(Shader& shader, const glm::mat4& modelMatrix,
+        const glm::mat3& normalMatrix);
+    // One MeshletDrawList per mesh
+    void drawClusters(Shader& shader, const glm::mat4& modelMatrix,
+        const glm::mat3& normalMatrix, const MeshletDrawList* clusters);
     void cleanup();
 
     // 
@@ -21,18 +78,45 @@ public:
 
     glm::mat4 getModelMatrix() const;
 
+    const std::vector<Mesh>& getMeshes() const { return meshes; }
+    const std::string& getPath() const { return path; }
+    const std::vector<std::string>& getSourceFiles() const {
+        return sourceFiles;
+    }
+    std::vector<std::string> getTexturePaths() const;
+    const Skeleton& getSkeleton() const { return skeleton; }
+    const std::vector<AnimationClip>& getClips() const { return clips; }
+    // Vertices carry bone weights; draw with skinned.vert
+    bool isSkinned() const { return !skeleton.boneJoints.empty(); }
+
 private:
+    std::string path;
+    std::vector<std::string> sourceFiles;
     std::vector<Mesh> meshes;
-    std::string directory;
     std::unordered_map<std::string, Texture> loadedTextures;
+    Skeleton skeleton;
+    std::vector<AnimationClip> clips;
+
+    void upload(ModelData& data);
+    // Creates a texture object unless one is given
+    GLuint uploadTexture(const ImageData& image, GLuint textureID = 0);
 
-    void loadModel(const std::string& path);
-    void processNode(aiNode* node, const aiScene* scene);
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-    std::vector<Texture> loadMaterialTextures(
+    static void processNode(aiNode* node, const aiScene* scene,
+        std::vector<aiMesh*>& out);
+    static MeshData processMesh(aiMesh* mesh, const aiScene* scene,
+        const std::string& directory,
+        const std::unordered_map<std::string, uint32_t>& boneIndex);
+    // Joints from the node hierarchy, bones from every mesh
+    static void buildSkeleton(const aiScene* scene,
+        const std::vector<aiMesh*>& meshes, Skeleton& skeleton,
+        std::unordered_map<std::string, uint32_t>& boneIndex);
+    static AnimationClip processAnimation(const aiAnimation* animation,
+        const Skeleton& skeleton);
+    static void collectMaterialTextures(
         aiMaterial* mat,
         aiTextureType type,
-        const std::string& typeName
+        const std::string& typeName,
+        const std::string& directory,
+        std::vector<Texture>& textures
     );
-    GLuint loadTextureFromFile(const std::string& path);
 };
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include "RenderTarget.h"
+#include <iostream>
+
+void RenderTarget::create(int width, int height, int samples) {
+    m_width = width;
+    m_height = height;
+    m_samples = samples;
+
+    // Color texture: render target without MSAA, resolve target with it
+    glGenTextures(1, &m_colorTexture);
+    glBindTexture(GL_TEXTURE_2D, m_colorTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0,
+        GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &m_depthRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_depthRBO);
+    if (samples > 1) {
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples,
+            GL_DEPTH24_STENCIL8, width, height);
+    }
+    else {
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8,
+            width, height);
+    }
+
+    glGenFramebuffers(1, &m_FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+
+    if (samples > 1) {
+        glGenRenderbuffers(1, &m_colorRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, m_colorRBO);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples,
+            GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+            GL_RENDERBUFFER, m_colorRBO);
+    }
+    else {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+            GL_TEXTURE_2D, m_colorTexture, 0);
+    }
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+        GL_RENDERBUFFER, m_depthRBO);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Render target " << width << "x" << height
+            << " (" << samples << "x) is incomplete" << std::endl;
+    }
+
+    if (samples > 1) {
+        glGenFramebuffers(1, &m_resolveFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_resolveFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+            GL_TEXTURE_2D, m_colorTexture, 0);
+    }
+
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void RenderTarget::cleanup() {
+    glDeleteFramebuffers(1, &m_FBO);
+    glDeleteFramebuffers(1, &m_resolveFBO);
+    glDeleteTextures(1, &m_colorTexture);
+    glDeleteRenderbuffers(1, &m_colorRBO);
+    glDeleteRenderbuffers(1, &m_depthRBO);
+    m_FBO = m_resolveFBO = m_colorTexture = m_colorRBO = m_depthRBO = 0;
+}
+
+void RenderTarget::bind() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+    glViewport(0, 0, m_width, m_height);
+}
+
+void RenderTarget::resolve() const {
+    if (m_samples <= 1) return;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_FBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_resolveFBO);
+    glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height,
+        GL_COLOR_BUFFER_BIT, GL_NEAREST);
+}
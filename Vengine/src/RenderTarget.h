@@ -0,0 +1,33 @@
+#pragma once
+#include <glad/glad.h>
+
+// Offscreen color + depth target. With samples > 1 rendering goes to
+// multisample renderbuffers and resolve() copies into the texture.
+class RenderTarget {
+public:
+    void create(int width, int height, int samples = 1);
+    void cleanup();
+
+    void bind() const;
+    // MSAA resolve into getColorTexture(); no-op without MSAA
+    void resolve() const;
+
+    // Framebuffer holding the single-sample (resolved) color
+    GLuint getResolveFramebuffer() const {
+        return m_samples > 1 ? m_resolveFBO : m_FBO;
+    }
+    GLuint getColorTexture() const { return m_colorTexture; }
+    int getWidth() const { return m_width; }
+    int getHeight() const { return m_height; }
+    int getSamples() const { return m_samples; }
+
+private:
+    GLuint m_FBO = 0;
+    GLuint m_resolveFBO = 0;
+    GLuint m_colorTexture = 0;
+    GLuint m_colorRBO = 0;    // MSAA only
+    GLuint m_depthRBO = 0;
+    int m_width = 0;
+    int m_height = 0;
+    int m_samples = 1;
+};
@@ -0,0 +1,242 @@
+#include "SceneBvh.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace {
+    const int STACK_SIZE = 96;
+    const size_t INSTANCE_GRAIN = 1024;
+}
+
+void SceneBvh::build(const World& world, JobSystem* jobs) {
+    size_t count = world.getEntityCount();
+    m_models.resize(count);
+    m_localMin.resize(count);
+    m_localMax.resize(count);
+
+    // Local bounds once per model, shared by its instances
+    std::unordered_map<const Model*, std::pair<glm::vec3, glm::vec3>> bounds;
+    for (size_t e = 0; e < count; e++) {
+        const Model* model = &world.getModel(static_cast<Entity>(e));
+        auto it = bounds.find(model);
+        if (it == bounds.end()) {
+            glm::vec3 boundsMin(0.0f), boundsMax(0.0f);
+            const auto& meshes = model->getMeshes();
+            for (size_t i = 0; i < meshes.size(); i++) {
+                boundsMin = i ? glm::min(boundsMin, meshes[i].boundsMin)
+                    : meshes[i].boundsMin;
+                boundsMax = i ? glm::max(boundsMax, meshes[i].boundsMax)
+                    : meshes[i].boundsMax;
+            }
+            it = bounds.emplace(model,
+                std::make_pair(boundsMin, boundsMax)).first;
+        }
+        m_models[e] = model;
+        m_localMin[e] = it->second.first;
+        m_localMax[e] = it->second.second;
+    }
+
+    updateInstances(world, jobs);
+    buildBvh(m_worldMin, m_worldMax, 1, m_nodes, m_order);
+}
+
+void SceneBvh::refit(const World& world, JobSystem* jobs) {
+    if (world.getEntityCount() != m_models.size()) {
+        build(world, jobs);
+        return;
+    }
+
+    updateInstances(world, jobs);
+
+    // Children are always stored after their parent
+    for (size_t i = m_nodes.size(); i-- > 0;) {
+        BvhNode& node = m_nodes[i];
+        if (node.count) {
+            node.boundsMin = m_worldMin[m_order[node.leftFirst]];
+            node.boundsMax = m_worldMax[m_order[node.leftFirst]];
+            for (uint32_t k = 1; k < node.count; k++) {
+                uint32_t e = m_order[node.leftFirst + k];
+                node.boundsMin = glm::min(node.boundsMin, m_worldMin[e]);
+                node.boundsMax = glm::max(node.boundsMax, m_worldMax[e]);
+            }
+        }
+        else {
+            const BvhNode& left = m_nodes[node.leftFirst];
+            const BvhNode& right = m_nodes[node.leftFirst + 1];
+            node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+            node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+        }
+    }
+}
+
+void SceneBvh::updateInstances(const World& world, JobSystem* jobs) {
+    size_t count = m_models.size();
+    m_worldMin.resize(count);
+    m_worldMax.resize(count);
+    m_toWorld.resize(count);
+    m_toLocal.resize(count);
+
+    auto update = [&](size_t begin, size_t end) {
+        for (size_t e = begin; e < end; e++) {
+            const glm::mat4& toWorld = world.getWorldMatrix(
+                static_cast<Entity>(e));
+            m_toWorld[e] = toWorld;
+            m_toLocal[e] = glm::inverse(toWorld);
+            transformBounds(toWorld, m_localMin[e], m_localMax[e],
+                m_worldMin[e], m_worldMax[e]);
+        }
+    };
+    if (jobs)
+        jobs->parallelFor(0, count, INSTANCE_GRAIN, update);
+    else
+        update(0, count);
+}
+
+bool SceneBvh::raycast(const Ray& ray, float maxDistance,
+    SceneHit& hit) const {
+    if (m_nodes.empty()) return false;
+
+    RayBoxTest box(ray);
+    uint32_t stack[STACK_SIZE];
+    int size = 0;
+    stack[size++] = 0;
+    bool found = false;
+
+    while (size > 0) {
+        const BvhNode& node = m_nodes[stack[--size]];
+        if (box.intersect(node, maxDistance) < 0.0f) continue;
+
+        if (!node.count) {
+            stack[size++] = node.leftFirst;
+            stack[size++] = node.leftFirst + 1;
+            continue;
+        }
+
+        for (uint32_t k = 0; k < node.count; k++) {
+            // Mesh space ray; t is unchanged by the affine transform
+            uint32_t e = m_order[node.leftFirst + k];
+            const glm::mat4& toLocal = m_toLocal[e];
+            Ray local;
+            local.origin = glm::vec3(toLocal * glm::vec4(ray.origin, 1.0f));
+            local.direction = glm::vec3(
+                toLocal * glm::vec4(ray.direction, 0.0f));
+
+            const auto& meshes = m_models[e]->getMeshes();
+            for (size_t m = 0; m < meshes.size(); m++) {
+                TriangleHit triangleHit;
+                if (meshes[m].bvh.raycast(local, maxDistance, triangleHit)) {
+                    maxDistance = triangleHit.t;
+                    hit.entity = static_cast<Entity>(e);
+                    hit.mesh = static_cast<uint32_t>(m);
+                    hit.triangle = triangleHit.triangle;
+                    hit.normal = triangleHit.normal;
+                    found = true;
+                }
+            }
+        }
+    }
+
+    if (found) {
+        // Normals go to world space with the inverse transpose
+        hit.distance = maxDistance;
+        hit.position = ray.origin + ray.direction * maxDistance;
+        hit.normal = glm::normalize(glm::transpose(
+            glm::mat3(m_toLocal[hit.entity])) * hit.normal);
+        if (glm::dot(hit.normal, ray.direction) > 0.0f)
+            hit.normal = -hit.normal;
+    }
+    return found;
+}
+
+void SceneBvh::overlapSphere(const glm::vec3& center, float radius,
+    std::vector<Entity>& entities) const {
+    if (m_nodes.empty()) return;
+
+    float radiusSq = radius * radius;
+    uint32_t stack[STACK_SIZE];
+    int size = 0;
+    stack[size++] = 0;
+    std::vector<uint32_t> triangles;
+
+    while (size > 0) {
+        const BvhNode& node = m_nodes[stack[--size]];
+        if (distanceSqToBox(center, node.boundsMin, node.boundsMax)
+            > radiusSq) continue;
+
+        if (!node.count) {
+            stack[size++] = node.leftFirst;
+            stack[size++] = node.leftFirst + 1;
+            continue;
+        }
+
+        for (uint32_t k = 0; k < node.count; k++) {
+            uint32_t e = m_order[node.leftFirst + k];
+            for (const auto& mesh : m_models[e]->getMeshes()) {
+                triangles.clear();
+                mesh.bvh.overlapSphere(m_toWorld[e], center, radius,
+                    triangles);
+                if (!triangles.empty()) {
+                    entities.push_back(static_cast<Entity>(e));
+                    break;
+                }
+            }
+        }
+    }
+}
+
+bool SceneBvh::nearestPoint(const glm::vec3& point, float maxDistance,
+    SceneHit& hit) const {
+    if (m_nodes.empty()) return false;
+
+    float bestDistanceSq = maxDistance * maxDistance;
+    struct Entry { uint32_t node; float distanceSq; };
+    Entry stack[STACK_SIZE];
+    int size = 0;
+    stack[size++] = { 0, distanceSqToBox(point,
+        m_nodes[0].boundsMin, m_nodes[0].boundsMax) };
+    bool found = false;
+
+    while (size > 0) {
+        Entry entry = stack[--size];
+        if (entry.distanceSq >= bestDistanceSq) continue;
+        const BvhNode& node = m_nodes[entry.node];
+
+        if (!node.count) {
+            // Farther child pushed first, nearer one searched first
+            uint32_t a = node.leftFirst, b = node.leftFirst + 1;
+            float da = distanceSqToBox(point,
+                m_nodes[a].boundsMin, m_nodes[a].boundsMax);
+            float db = distanceSqToBox(point,
+                m_nodes[b].boundsMin, m_nodes[b].boundsMax);
+            if (da < db) {
+                std::swap(a, b);
+                std::swap(da, db);
+            }
+            stack[size++] = { a, da };
+            stack[size++] = { b, db };
+            continue;
+        }
+
+        for (uint32_t k = 0; k < node.count; k++) {
+            uint32_t e = m_order[node.leftFirst + k];
+            const auto& meshes = m_models[e]->getMeshes();
+            for (size_t m = 0; m < meshes.size(); m++) {
+                if (meshes[m].bvh.nearestPoint(m_toWorld[e], point,
+                    bestDistanceSq, hit.position, hit.triangle)) {
+                    hit.entity = static_cast<Entity>(e);
+                    hit.mesh = static_cast<uint32_t>(m);
+                    found = true;
+                }
+            }
+        }
+    }
+
+    if (found) {
+        hit.distance = std::sqrt(bestDistanceSq);
+        glm::vec3 offset = point - hit.position;
+        hit.normal = hit.distance > 0.0f ? offset / hit.distance
+            : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+    return found;
+}
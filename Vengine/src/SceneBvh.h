@@ -0,0 +1,52 @@
+#pragma once
+#include "Bvh.h"
+#include "World.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+class JobSystem;
+
+struct SceneHit {
+    Entity entity = 0;
+    uint32_t mesh = 0;        // index into Model::getMeshes()
+    uint32_t triangle = 0;
+    float distance = 0.0f;
+    glm::vec3 position;       // world space
+    // World space, normalized; for nearestPoint it points from the
+    // surface to the query point
+    glm::vec3 normal;
+};
+
+// Top-level BVH over the entities of a World; each leaf holds one entity
+// whose meshes are searched through their own MeshBvh. refit() updates
+// the bounds for new transforms and keeps the tree topology.
+class SceneBvh {
+public:
+    // Call after World::updateTransforms
+    void build(const World& world, JobSystem* jobs = nullptr);
+    // Rebuilds instead when entities were added since build()
+    void refit(const World& world, JobSystem* jobs = nullptr);
+
+    // direction must be normalized, distances are world units
+    bool raycast(const Ray& ray, float maxDistance, SceneHit& hit) const;
+    // Entities with at least one triangle inside the sphere
+    void overlapSphere(const glm::vec3& center, float radius,
+        std::vector<Entity>& entities) const;
+    // Closest surface point within maxDistance
+    bool nearestPoint(const glm::vec3& point, float maxDistance,
+        SceneHit& hit) const;
+
+    size_t getInstanceCount() const { return m_models.size(); }
+
+private:
+    std::vector<BvhNode> m_nodes;
+    std::vector<uint32_t> m_order;       // leaf order -> entity
+
+    // Per entity
+    std::vector<const Model*> m_models;
+    std::vector<glm::vec3> m_localMin, m_localMax;
+    std::vector<glm::vec3> m_worldMin, m_worldMax;
+    std::vector<glm::mat4> m_toWorld, m_toLocal;
+
+    void updateInstances(const World& world, JobSystem* jobs);
+};
@@ -5,9 +5,54 @@
 #include <iostream>
 
 Shader::Shader(const std::string& vertexPath,
-    const std::string& fragmentPath) {
-    std::string vertexCode = loadShaderSource(vertexPath);
-    std::string fragmentCode = loadShaderSource(fragmentPath);
+    const std::string& fragmentPath)
+    : sources{ vertexPath, fragmentPath } {
+    bool success;
+    ID = compile(success);
+}
+
+Shader::Shader(const std::string& computePath)
+    : sources{ computePath } {
+    bool success;
+    ID = compile(success);
+}
+
+bool Shader::reload() {
+    // A broken edit keeps the last working program
+    bool success;
+    GLuint program = compile(success);
+    if (!success) {
+        glDeleteProgram(program);
+        return false;
+    }
+    glDeleteProgram(ID);
+    ID = program;
+    return true;
+}
+
+GLuint Shader::compile(bool& success) {
+    success = true;
+
+    if (sources.size() == 1) {
+        std::string computeCode = loadShaderSource(sources[0]);
+        const char* cShaderCode = computeCode.c_str();
+
+        GLuint compute = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute, 1, &cShaderCode, nullptr);
+        glCompileShader(compute);
+        success &= checkCompileErrors(compute, "COMPUTE");
+
+        GLuint program = glCreateProgram();
+        glAttachShader(program, compute);
+        glLinkProgram(program);
+        success &= checkCompileErrors(program, "PROGRAM");
+
+        glDeleteShader(compute);
+        return program;
+    }
+
+    std::string vertexCode = loadShaderSource(sources[0]);
+    std::string fragmentCode = loadShaderSource(sources[1]);
 
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
@@ -16,23 +61,24 @@ Shader::Shader(const std::string& vertexPath,
     GLuint vertex = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vertex, 1, &vShaderCode, nullptr);
     glCompileShader(vertex);
-    checkCompileErrors(vertex, "VERTEX");
+    success &= checkCompileErrors(vertex, "VERTEX");
 
     //   
     GLuint fragment = glCreateShader(GL_FRAGMENT_SHADER);
     glShaderSource(fragment, 1, &fShaderCode, nullptr);
     glCompileShader(fragment);
-    checkCompileErrors(fragment, "FRAGMENT");
+    success &= checkCompileErrors(fragment, "FRAGMENT");
 
     //  
-    ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
-    glLinkProgram(ID);
-    checkCompileErrors(ID, "PROGRAM");
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    glLinkProgram(program);
+    success &= checkCompileErrors(program, "PROGRAM");
 
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+    return program;
 }
 
 Shader::~Shader() {
@@ -51,6 +97,19 @@ void Shader::setMat4(const std::string& name,
     );
 }
 
+void Shader::setMat3(const std::string& name,
+    const glm::mat3& value) const {
+    glUniformMatrix3fv(
+        glGetUniformLocation(ID, name.c_str()),
+        1, GL_FALSE, glm::value_ptr(value)
+    );
+}
+
+void Shader::setVec2(const std::string& name,
+    const glm::vec2& value) const {
+    glUniform2f(glGetUniformLocation(ID, name.c_str()), value.x, value.y);
+}
+
 void Shader::setVec3(const std::string& name,
     const glm::vec3& value) const {
     glUniform3fv(
@@ -82,7 +141,7 @@ std::string Shader::loadShaderSource(const std::string& path) {
     return buffer.str();
 }
 
-void Shader::checkCompileErrors(GLuint shader,
+bool Shader::checkCompileErrors(GLuint shader,
     const std::string& type) {
     int success;
     char infoLog[1024];
@@ -102,4 +161,5 @@ void Shader::checkCompileErrors(GLuint shader,
             std::cerr << "Program linking error: " << infoLog << std::endl;
         }
     }
+    return success != 0;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <string>
+#include <vector>
 
 class Shader {
 public:
@@ -9,19 +10,28 @@ public:
 
     Shader(const std::string& vertexPath,
         const std::string& fragmentPath);
+    explicit Shader(const std::string& computePath);
     ~Shader();
 
     void use() const;
+    // Recompiles from the source files; on errors the old program stays
+    bool reload();
+    const std::vector<std::string>& getSources() const { return sources; }
 
     // Uniform 
     void setBool(const std::string& name, bool value) const;
     void setInt(const std::string& name, int value) const;
     void setFloat(const std::string& name, float value) const;
+    void setVec2(const std::string& name, const glm::vec2& value) const;
     void setVec3(const std::string& name, const glm::vec3& value) const;
     void setVec4(const std::string& name, const glm::vec4& value) const;
+    void setMat3(const std::string& name, const glm::mat3& value) const;
     void setMat4(const std::string& name, const glm::mat4& value) const;
 
 private:
-    void checkCompileErrors(GLuint shader, const std::string& type);
+    std::vector<std::string> sources;  // vertex + fragment, or compute
+
+    GLuint compile(bool& success);
+    bool checkCompileErrors(GLuint shader, const std::string& type);
     std::string loadShaderSource(const std::string& path);
 };
\ No newline at end of file
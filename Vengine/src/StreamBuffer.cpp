@@ -0,0 +1,159 @@
+#include "StreamBuffer.h"
+#include <iostream>
+#include <stdexcept>
+
+StreamBuffer::StreamBuffer(GLenum target, GLsizeiptr frameSize,
+    int frameCount)
+    : m_target(target),
+    m_frameCount(frameCount),
+    m_persistent(persistentSupported())
+{
+    // Every region starts at a bindable offset
+    GLsizeiptr alignment = offsetAlignment(target);
+    m_frameSize = (frameSize + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &m_buffer);
+    // GL_COPY_WRITE_BUFFER does not touch VAO or indexed bindings
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+
+    if (m_persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT
+            | GL_MAP_COHERENT_BIT;
+        GLsizeiptr total = m_frameSize * m_frameCount;
+
+        glBufferStorage(GL_COPY_WRITE_BUFFER, total, nullptr, flags);
+        m_mapped = static_cast<unsigned char*>(
+            glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, total, flags));
+        m_fences.assign(m_frameCount, nullptr);
+
+        if (!m_mapped) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            glDeleteBuffers(1, &m_buffer);
+            throw std::runtime_error("Failed to map stream buffer");
+        }
+    }
+    else {
+        // One region only: orphaning gives the driver a fresh block
+        glBufferData(GL_COPY_WRITE_BUFFER, m_frameSize, nullptr,
+            GL_STREAM_DRAW);
+        m_shadow.resize(m_frameSize);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+StreamBuffer::~StreamBuffer() {
+    for (GLsync fence : m_fences) {
+        if (fence) glDeleteSync(fence);
+    }
+
+    if (m_mapped) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &m_buffer);
+}
+
+bool StreamBuffer::persistentSupported() {
+    return GLAD_GL_VERSION_4_4 != 0;
+}
+
+GLsizeiptr StreamBuffer::offsetAlignment(GLenum target) {
+    GLint alignment = 16;
+    if (target == GL_UNIFORM_BUFFER)
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    else if (target == GL_SHADER_STORAGE_BUFFER)
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    return alignment;
+}
+
+void StreamBuffer::waitFence(int frame) {
+    GLsync& fence = m_fences[frame];
+    if (!fence) return;
+
+    // Normally already signaled: we are frameCount - 1 frames ahead
+    GLbitfield flags = 0;
+    GLuint64 timeout = 0;
+    for (;;) {
+        GLenum result = glClientWaitSync(fence, flags, timeout);
+        if (result == GL_ALREADY_SIGNALED
+            || result == GL_CONDITION_SATISFIED) {
+            break;
+        }
+        if (result == GL_WAIT_FAILED) {
+            std::cerr << "StreamBuffer: glClientWaitSync failed"
+                << std::endl;
+            break;
+        }
+        flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        timeout = 1000000000; // 1 s
+    }
+
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void StreamBuffer::beginFrame() {
+    m_head = 0;
+    m_flushed = 0;
+
+    if (m_persistent) {
+        m_frame = (m_frame + 1) % m_frameCount;
+        waitFence(m_frame);
+    }
+    else {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, m_frameSize, nullptr,
+            GL_STREAM_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(GLsizeiptr size,
+    GLsizeiptr alignment) {
+    if (alignment <= 0) {
+        throw std::invalid_argument(
+            "StreamBuffer: alignment must be positive");
+    }
+    // Align the offset inside the whole buffer, not inside the region
+    GLsizeiptr base = m_persistent ? m_frame * m_frameSize : 0;
+    GLsizeiptr start = (base + m_head + alignment - 1) / alignment
+        * alignment - base;
+    if (start + size > m_frameSize) {
+        throw std::runtime_error(
+            "StreamBuffer: frame region overflow, increase frameSize");
+    }
+    m_head = start + size;
+
+    Allocation alloc;
+    alloc.size = size;
+    if (m_persistent) {
+        alloc.offset = base + start;
+        alloc.data = m_mapped + alloc.offset;
+    }
+    else {
+        alloc.offset = start;
+        alloc.data = m_shadow.data() + start;
+    }
+    return alloc;
+}
+
+void StreamBuffer::flush() {
+    if (m_persistent || m_flushed == m_head) return;
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, m_flushed, m_head - m_flushed,
+        m_shadow.data() + m_flushed);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    m_flushed = m_head;
+}
+
+void StreamBuffer::endFrame() {
+    if (m_persistent) {
+        m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    else {
+        flush();
+    }
+}
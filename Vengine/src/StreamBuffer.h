@@ -0,0 +1,57 @@
+#pragma once
+#include <glad/glad.h>
+#include <vector>
+
+// Ring buffer for per-frame data (instances, debug lines, particles).
+// GL 4.4+: one persistently mapped buffer split into frame regions,
+// each region guarded by a fence. GL 3.3: buffer orphaning.
+class StreamBuffer {
+public:
+    struct Allocation {
+        void* data;        // CPU-visible write pointer
+        GLintptr offset;   // offset inside getID() for binding/drawing
+        GLsizeiptr size;
+    };
+
+    // frameSize is rounded up to offsetAlignment(target)
+    StreamBuffer(GLenum target, GLsizeiptr frameSize, int frameCount = 3);
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // Switches to the next frame region (waits for the GPU if needed)
+    void beginFrame();
+    // offset is a multiple of alignment (> 0)
+    Allocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16);
+    // Makes written data visible to the GPU; no-op when persistent
+    void flush();
+    // Fences the current region; call after the last draw using it
+    void endFrame();
+
+    GLuint getID() const { return m_buffer; }
+    GLenum getTarget() const { return m_target; }
+    GLsizeiptr getFrameSize() const { return m_frameSize; }
+    bool isPersistent() const { return m_persistent; }
+
+    static bool persistentSupported();
+    // GL_UNIFORM_BUFFER / GL_SHADER_STORAGE_BUFFER offset alignment
+    static GLsizeiptr offsetAlignment(GLenum target);
+
+private:
+    GLenum m_target;
+    GLuint m_buffer = 0;
+    GLsizeiptr m_frameSize;
+    int m_frameCount;
+    bool m_persistent;
+
+    int m_frame = 0;
+    GLsizeiptr m_head = 0;
+    GLsizeiptr m_flushed = 0;
+
+    unsigned char* m_mapped = nullptr;   // persistent mapping
+    std::vector<GLsync> m_fences;
+    std::vector<unsigned char> m_shadow; // orphaning fallback
+
+    void waitFence(int frame);
+};
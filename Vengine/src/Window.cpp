@@ -10,7 +10,8 @@ static GLFWwindow* tryCreateWindow(int major, int minor, int width, int height,
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_SAMPLES, 4); // MSAA
+    // MSAA is done on offscreen targets (DynamicResolution)
+    glfwWindowHint(GLFW_SAMPLES, 0);
 
     GLFWwindow* window = glfwCreateWindow(width, height, title.c_str(),
         nullptr, nullptr);
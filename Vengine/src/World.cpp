@@ -0,0 +1,324 @@
+#include "World.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <mutex>
+
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VENGINE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace {
+    // Sort key layout: | render handle 16 | depth 24 | entity 24 |
+    const uint64_t ENTITY_MASK = 0xFFFFFF;
+    const size_t MAX_RENDER_HANDLES = size_t(1) << 16;
+    const size_t MAX_ENTITIES = size_t(1) << 24;
+    const float SORT_DEPTH_RANGE = 1000.0f;   // camera far plane
+
+    // Entities per job
+    const size_t TRANSFORM_GRAIN = 1024;
+    const size_t CULL_GRAIN = 2048;
+    const size_t CLUSTER_GRAIN = 16;
+
+    template <typename F>
+    void forRange(JobSystem* jobs, size_t count, size_t grain, const F& body) {
+        if (jobs)
+            jobs->parallelFor(0, count, grain, body);
+        else
+            body(0, count);
+    }
+}
+
+uint32_t World::addModel(Model& model) {
+    assert(m_models.size() < MAX_RENDER_HANDLES);
+    m_models.push_back(&model);
+    m_modelSpheres.push_back(glm::vec4(0.0f));
+    m_modelMeshlets.push_back(0);
+
+    uint32_t renderHandle = static_cast<uint32_t>(m_models.size()) - 1;
+    refreshModel(renderHandle);
+    return renderHandle;
+}
+
+void World::refreshModel(uint32_t renderHandle) {
+    glm::vec3 boundsMin(0.0f), boundsMax(0.0f);
+    size_t meshlets = 0;
+    const auto& meshes = m_models[renderHandle]->getMeshes();
+    for (size_t i = 0; i < meshes.size(); i++) {
+        boundsMin = i ? glm::min(boundsMin, meshes[i].boundsMin)
+            : meshes[i].boundsMin;
+        boundsMax = i ? glm::max(boundsMax, meshes[i].boundsMax)
+            : meshes[i].boundsMax;
+        meshlets += meshes[i].meshlets.size();
+    }
+
+    m_modelSpheres[renderHandle] = glm::vec4((boundsMin + boundsMax) * 0.5f,
+        glm::length(boundsMax - boundsMin) * 0.5f);
+    m_modelMeshlets[renderHandle] = meshlets;
+}
+
+Entity World::createEntity(uint32_t renderHandle) {
+    assert(renderHandle < m_models.size());
+    assert(m_renderHandles.size() < MAX_ENTITIES);
+    m_position.push(glm::vec3(0.0f));
+    m_rotation.push(glm::vec3(0.0f));
+    m_scale.push(glm::vec3(1.0f));
+    m_renderHandles.push_back(renderHandle);
+
+    m_world.push_back(glm::mat4(1.0f));
+    m_normal.push_back(glm::mat3(1.0f));
+    m_spheres.push_back(m_modelSpheres[renderHandle]);
+    return static_cast<Entity>(m_renderHandles.size()) - 1;
+}
+
+void World::setPosition(Entity e, const glm::vec3& position) {
+    m_position.set(e, position);
+}
+
+void World::setRotation(Entity e, const glm::vec3& degrees) {
+    m_rotation.set(e, degrees);
+}
+
+void World::setScale(Entity e, const glm::vec3& scale) {
+    m_scale.set(e, scale);
+}
+
+void World::updateTransforms(JobSystem* jobs) {
+    forRange(jobs, getEntityCount(), TRANSFORM_GRAIN,
+        [this](size_t begin, size_t end) { updateTransforms(begin, end); });
+}
+
+// Same result as Model::getModelMatrix: T * Rx * Ry * Rz * S
+void World::transformScalar(size_t i) {
+    float rx = glm::radians(m_rotation.x[i]);
+    float ry = glm::radians(m_rotation.y[i]);
+    float rz = glm::radians(m_rotation.z[i]);
+    float sx = std::sin(rx), cx = std::cos(rx);
+    float sy = std::sin(ry), cy = std::cos(ry);
+    float sz = std::sin(rz), cz = std::cos(rz);
+
+    glm::mat3 r;
+    r[0] = glm::vec3(cy * cz, sx * sy * cz + cx * sz, sx * sz - cx * sy * cz);
+    r[1] = glm::vec3(-cy * sz, cx * cz - sx * sy * sz, cx * sy * sz + sx * cz);
+    r[2] = glm::vec3(sy, -sx * cy, cx * cy);
+
+    glm::vec3 s = m_scale.get(i);
+    glm::mat4& world = m_world[i];
+    world[0] = glm::vec4(r[0] * s.x, 0.0f);
+    world[1] = glm::vec4(r[1] * s.y, 0.0f);
+    world[2] = glm::vec4(r[2] * s.z, 0.0f);
+    world[3] = glm::vec4(m_position.get(i), 1.0f);
+
+    // inverse(transpose(R * S)) == R * inverse(S)
+    glm::mat3& normal = m_normal[i];
+    normal[0] = r[0] / s.x;
+    normal[1] = r[1] / s.y;
+    normal[2] = r[2] / s.z;
+}
+
+void World::updateTransforms(size_t begin, size_t end) {
+    size_t i = begin;
+
+#ifdef VENGINE_SSE
+    // 4 entities per iteration: rotation/scale are combined in SoA form,
+    // then transposed into the per-entity column-major matrices
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for (; i + 4 <= end; i += 4) {
+        alignas(16) float sin3[3][4], cos3[3][4];
+        const std::vector<float>* angles[3] = {
+            &m_rotation.x, &m_rotation.y, &m_rotation.z };
+        for (int a = 0; a < 3; a++) {
+            for (int k = 0; k < 4; k++) {
+                float r = glm::radians((*angles[a])[i + k]);
+                sin3[a][k] = std::sin(r);
+                cos3[a][k] = std::cos(r);
+            }
+        }
+
+        __m128 sx = _mm_load_ps(sin3[0]), cx = _mm_load_ps(cos3[0]);
+        __m128 sy = _mm_load_ps(sin3[1]), cy = _mm_load_ps(cos3[1]);
+        __m128 sz = _mm_load_ps(sin3[2]), cz = _mm_load_ps(cos3[2]);
+        __m128 sxsy = _mm_mul_ps(sx, sy);
+        __m128 cxsy = _mm_mul_ps(cx, sy);
+
+        // R[column][row]
+        __m128 r[3][3];
+        r[0][0] = _mm_mul_ps(cy, cz);
+        r[0][1] = _mm_add_ps(_mm_mul_ps(sxsy, cz), _mm_mul_ps(cx, sz));
+        r[0][2] = _mm_sub_ps(_mm_mul_ps(sx, sz), _mm_mul_ps(cxsy, cz));
+        r[1][0] = _mm_sub_ps(zero, _mm_mul_ps(cy, sz));
+        r[1][1] = _mm_sub_ps(_mm_mul_ps(cx, cz), _mm_mul_ps(sxsy, sz));
+        r[1][2] = _mm_add_ps(_mm_mul_ps(cxsy, sz), _mm_mul_ps(sx, cz));
+        r[2][0] = sy;
+        r[2][1] = _mm_sub_ps(zero, _mm_mul_ps(sx, cy));
+        r[2][2] = _mm_mul_ps(cx, cy);
+
+        __m128 scale[3] = {
+            _mm_loadu_ps(&m_scale.x[i]),
+            _mm_loadu_ps(&m_scale.y[i]),
+            _mm_loadu_ps(&m_scale.z[i]) };
+
+        for (int c = 0; c < 3; c++) {
+            __m128 a = _mm_mul_ps(r[c][0], scale[c]);
+            __m128 b = _mm_mul_ps(r[c][1], scale[c]);
+            __m128 d = _mm_mul_ps(r[c][2], scale[c]);
+            __m128 w = zero;
+            _MM_TRANSPOSE4_PS(a, b, d, w);
+            _mm_storeu_ps(&m_world[i + 0][c].x, a);
+            _mm_storeu_ps(&m_world[i + 1][c].x, b);
+            _mm_storeu_ps(&m_world[i + 2][c].x, d);
+            _mm_storeu_ps(&m_world[i + 3][c].x, w);
+
+            __m128 invScale = _mm_div_ps(one, scale[c]);
+            alignas(16) float n[3][4];
+            _mm_store_ps(n[0], _mm_mul_ps(r[c][0], invScale));
+            _mm_store_ps(n[1], _mm_mul_ps(r[c][1], invScale));
+            _mm_store_ps(n[2], _mm_mul_ps(r[c][2], invScale));
+            for (int k = 0; k < 4; k++) {
+                m_normal[i + k][c] = glm::vec3(n[0][k], n[1][k], n[2][k]);
+            }
+        }
+
+        __m128 px = _mm_loadu_ps(&m_position.x[i]);
+        __m128 py = _mm_loadu_ps(&m_position.y[i]);
+        __m128 pz = _mm_loadu_ps(&m_position.z[i]);
+        __m128 pw = one;
+        _MM_TRANSPOSE4_PS(px, py, pz, pw);
+        _mm_storeu_ps(&m_world[i + 0][3].x, px);
+        _mm_storeu_ps(&m_world[i + 1][3].x, py);
+        _mm_storeu_ps(&m_world[i + 2][3].x, pz);
+        _mm_storeu_ps(&m_world[i + 3][3].x, pw);
+    }
+#endif
+
+    for (; i < end; i++) {
+        transformScalar(i);
+    }
+
+    // World-space bounding spheres
+    for (i = begin; i < end; i++) {
+        const glm::vec4& local = m_modelSpheres[m_renderHandles[i]];
+        const glm::mat4& world = m_world[i];
+        glm::vec3 center = glm::vec3(world * glm::vec4(glm::vec3(local), 1.0f));
+        glm::vec3 s = glm::abs(m_scale.get(i));
+        m_spheres[i] = glm::vec4(center,
+            local.w * std::max(s.x, std::max(s.y, s.z)));
+    }
+}
+
+FrameList<Entity> World::cull(const Frustum& frustum, FrameArena& arena,
+    JobSystem* jobs) const {
+    size_t count = getEntityCount();
+
+    // Visibility flags in parallel, then an ordered compaction
+    unsigned char* flags = arena.allocate<unsigned char>(count);
+    forRange(jobs, count, CULL_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t e = begin; e < end; e++) {
+            const glm::vec4& s = m_spheres[e];
+            flags[e] = frustum.intersectsSphere(glm::vec3(s), s.w);
+        }
+    });
+
+    FrameList<Entity> visible(arena, count);
+    for (size_t e = 0; e < count; e++) {
+        if (flags[e]) visible.push_back(static_cast<Entity>(e));
+    }
+    return visible;
+}
+
+FrameList<uint64_t> World::buildDrawList(const FrameList<Entity>& visible,
+    const glm::vec3& viewPos, FrameArena& arena, JobSystem* jobs) const {
+    FrameList<uint64_t> keys(arena, visible.size);
+    keys.size = visible.size;
+
+    forRange(jobs, visible.size, CULL_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Entity e = visible[i];
+            float depth = glm::distance(viewPos, glm::vec3(m_spheres[e]));
+            depth = std::min(depth / SORT_DEPTH_RANGE, 1.0f);
+            uint64_t depthBits = static_cast<uint64_t>(depth * ENTITY_MASK);
+
+            keys[i] = (uint64_t)m_renderHandles[e] << 48
+                | depthBits << 24 | e;
+        }
+    });
+
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+void World::draw(const FrameList<uint64_t>& drawList, Shader& shader) const {
+    for (uint64_t key : drawList) {
+        Entity e = static_cast<Entity>(key & ENTITY_MASK);
+        m_models[m_renderHandles[e]]->draw(shader, m_world[e], m_normal[e]);
+    }
+}
+
+ClusterStats World::drawClusters(const FrameList<uint64_t>& drawList,
+    const Frustum& frustum, const glm::vec3& viewPos, Shader& shader,
+    FrameArena& arena, JobSystem* jobs) const {
+    size_t count = drawList.size;
+
+    // Slots per draw entry: one range per meshlet, one list per mesh
+    size_t* rangeBase = arena.allocate<size_t>(count + 1);
+    size_t* meshBase = arena.allocate<size_t>(count + 1);
+    rangeBase[0] = meshBase[0] = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t handle = m_renderHandles[drawList[i] & ENTITY_MASK];
+        rangeBase[i + 1] = rangeBase[i] + m_modelMeshlets[handle];
+        meshBase[i + 1] = meshBase[i]
+            + m_models[handle]->getMeshes().size();
+    }
+
+    GLsizei* counts = arena.allocate<GLsizei>(rangeBase[count]);
+    const void** offsets = arena.allocate<const void*>(rangeBase[count]);
+    MeshletDrawList* clusters =
+        arena.allocate<MeshletDrawList>(meshBase[count]);
+
+    ClusterStats stats;
+    std::mutex statsMutex;
+    forRange(jobs, count, CLUSTER_GRAIN, [&](size_t begin, size_t end) {
+        ClusterStats local;
+        for (size_t i = begin; i < end; i++) {
+            Entity e = static_cast<Entity>(drawList[i] & ENTITY_MASK);
+            const glm::mat4& world = m_world[e];
+
+            // Test in mesh space: frustum and camera move, meshlets don't
+            Frustum meshFrustum = localFrustum(frustum, world);
+            glm::vec3 camera = glm::vec3(
+                glm::inverse(world) * glm::vec4(viewPos, 1.0f));
+
+            size_t range = rangeBase[i];
+            const auto& meshes = m_models[m_renderHandles[e]]->getMeshes();
+            for (size_t m = 0; m < meshes.size(); m++) {
+                MeshletDrawList& list = clusters[meshBase[i] + m];
+                list.counts = counts + range;
+                list.offsets = offsets + range;
+                list.drawCount = cullMeshlets(meshes[m].meshlets,
+                    meshFrustum, camera, counts + range, offsets + range,
+                    local);
+                range += meshes[m].meshlets.size();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.add(local);
+    });
+
+    // Rejected clusters are back faces only; cull the rest per triangle
+    // too so the image does not depend on which clusters survived
+    glEnable(GL_CULL_FACE);
+    for (size_t i = 0; i < count; i++) {
+        Entity e = static_cast<Entity>(drawList[i] & ENTITY_MASK);
+        m_models[m_renderHandles[e]]->drawClusters(shader, m_world[e],
+            m_normal[e], clusters + meshBase[i]);
+    }
+    glDisable(GL_CULL_FACE);
+
+    return stats;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "FrameArena.h"
+#include "Frustum.h"
+#include "Model.h"
+#include "Shader.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+using Entity = uint32_t;
+
+// Data-oriented scene storage. Components live in structure-of-arrays
+// pools indexed by entity; world/normal matrices and world bounds of
+// all entities are computed at once by updateTransforms().
+class World {
+public:
+    // Registers a model and returns its render handle. Sort keys hold
+    // at most 2^16 models and 2^24 entities.
+    uint32_t addModel(Model& model);
+    // Recomputes the cached bounds after the model was reloaded
+    void refreshModel(uint32_t renderHandle);
+    Entity createEntity(uint32_t renderHandle);
+    size_t getEntityCount() const { return m_renderHandles.size(); }
+
+    void setPosition(Entity e, const glm::vec3& position);
+    void setRotation(Entity e, const glm::vec3& degrees);
+    void setScale(Entity e, const glm::vec3& scale);
+    glm::vec3 getPosition(Entity e) const { return m_position.get(e); }
+    glm::vec3 getRotation(Entity e) const { return m_rotation.get(e); }
+    glm::vec3 getScale(Entity e) const { return m_scale.get(e); }
+    const Model& getModel(Entity e) const {
+        return *m_models[m_renderHandles[e]];
+    }
+
+    // Batches of entities run as jobs when a JobSystem is given
+    void updateTransforms(JobSystem* jobs = nullptr);
+    void updateTransforms(size_t begin, size_t end);
+
+    const glm::mat4& getWorldMatrix(Entity e) const { return m_world[e]; }
+    const glm::mat3& getNormalMatrix(Entity e) const { return m_normal[e]; }
+    // xyz = world-space center, w = radius
+    const glm::vec4& getWorldSphere(Entity e) const { return m_spheres[e]; }
+
+    FrameList<Entity> cull(const Frustum& frustum, FrameArena& arena,
+        JobSystem* jobs = nullptr) const;
+    // Sorted by render handle (fewer state changes), then front to back
+    FrameList<uint64_t> buildDrawList(const FrameList<Entity>& visible,
+        const glm::vec3& viewPos, FrameArena& arena,
+        JobSystem* jobs = nullptr) const;
+    void draw(const FrameList<uint64_t>& drawList, Shader& shader) const;
+    // Like draw(), but meshlets outside the frustum or facing away from
+    // viewPos are rejected first (as jobs); the rest of each mesh is one
+    // multi-draw. Back-face culling is enabled while drawing, so unlike
+    // draw() and the GPU-driven path, double-sided or inconsistently
+    // wound geometry loses its back faces here.
+    ClusterStats drawClusters(const FrameList<uint64_t>& drawList,
+        const Frustum& frustum, const glm::vec3& viewPos, Shader& shader,
+        FrameArena& arena, JobSystem* jobs = nullptr) const;
+
+private:
+    struct Vec3Pool {
+        std::vector<float> x, y, z;
+
+        void push(const glm::vec3& v) {
+            x.push_back(v.x); y.push_back(v.y); z.push_back(v.z);
+        }
+        void set(size_t i, const glm::vec3& v) {
+            x[i] = v.x; y[i] = v.y; z[i] = v.z;
+        }
+        glm::vec3 get(size_t i) const { return glm::vec3(x[i], y[i], z[i]); }
+    };
+
+    // Components
+    Vec3Pool m_position;
+    Vec3Pool m_rotation;   // degrees, applied X then Y then Z (as Model)
+    Vec3Pool m_scale;
+    std::vector<uint32_t> m_renderHandles;
+
+    // Kernel outputs
+    std::vector<glm::mat4> m_world;
+    std::vector<glm::mat3> m_normal;
+    std::vector<glm::vec4> m_spheres;
+
+    // Render handle -> model, its local bounding sphere and meshlet count
+    std::vector<Model*> m_models;
+    std::vector<glm::vec4> m_modelSpheres;
+    std::vector<size_t> m_modelMeshlets;
+
+    void transformScalar(size_t i);
+};
@@ -1,8 +1,22 @@
 #include "Window.h"
+#include "AssetDatabase.h"
 #include "Shader.h"
 #include "Model.h"
 #include "Camera.h"
+#include "GpuScene.h"
+#include "World.h"
+#include "SceneBvh.h"
+#include "DynamicResolution.h"
+#include "JobSystem.h"
+#include "Benchmark.h"
+#include "BoneBuffer.h"
 #include <iostream>
+#include <memory>
+#include <string>
+
+#ifdef VENGINE_ALLOCATION_CHECK
+#include "AllocationCheck.h"
+#endif
 
 //  
 Camera camera;
@@ -10,12 +24,18 @@ float lastX = 640, lastY = 360;
 bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
+bool gpuDriven = true;      // GPU culling path when GL 4.3 is available
 
 void mouseCallback(GLFWwindow* window, double xpos, double ypos);
 void scrollCallback(GLFWwindow* window, double xoffset, double yoffset);
-void processInput(GLFWwindow* window);
+void processInput(GLFWwindow* window, DynamicResolution& resolution);
+
+int main(int argc, char** argv) {
+    // Headless benchmarks, no window or GL context
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        return runBenchmarks(argc, argv);
+    }
 
-int main() {
     try {
         //  
         Window window(1280, 720, "My 3D Engine");
@@ -30,10 +50,67 @@ int main() {
         Shader shader("assets/shaders/basic.vert",
             "assets/shaders/basic.frag");
 
+        // Offscreen-   
+        DynamicResolution resolution(16.6f);
+        resolution.setAntiAliasing(AntiAliasing::MSAA, 4);
+
         //  
-        Model model("assets/models/Cube.fbx");
-        model.position = glm::vec3(0.0f, 0.0f, 0.0f);
-        model.scale = glm::vec3(1.0f);
+        JobSystem jobs;
+        Model model("assets/models/Cube.fbx", &jobs);
+
+        // : SoA- +    
+        World world;
+        uint32_t modelHandle = world.addModel(model);
+        Entity entity = world.createEntity(modelHandle);
+        world.setPosition(entity, glm::vec3(0.0f, 0.0f, 0.0f));
+        world.setScale(entity, glm::vec3(1.0f));
+        FrameArena frameArena;
+        SceneBvh sceneBvh;
+        bool pickHeld = false;
+
+        // GPU-driven path: compute culling + indirect draws (GL 4.3+)
+        std::unique_ptr<GpuScene> gpuScene;
+        std::unique_ptr<Shader> indirectShader;
+        if (GpuScene::isSupported()) {
+            gpuScene = std::make_unique<GpuScene>();
+            gpuScene->addInstance(model);
+            gpuScene->build();
+            indirectShader = std::make_unique<Shader>(
+                "assets/shaders/indirect.vert",
+                "assets/shaders/basic.frag");
+        }
+
+        // Skinned models play their first clip; poses are built as jobs
+        Animator animator;
+        BoneBuffer boneBuffer;
+        Shader skinnedShader("assets/shaders/skinned.vert",
+            "assets/shaders/basic.frag");
+        BoneBuffer::setupShader(skinnedShader);
+        int animated = -1;
+        auto setupAnimation = [&]() {
+            animator.clear();
+            animated = -1;
+            if (!model.isSkinned()) return;
+            animated = animator.addInstance(model.getSkeleton());
+            if (!model.getClips().empty())
+                animator.getState(animated).clip = &model.getClips()[0];
+        };
+        setupAnimation();
+
+        // Hot reload: edited files are re-imported in the background and
+        // swapped in between frames, caches built from them are refreshed
+        AssetDatabase assets;
+        assets.addShader(shader);
+        assets.addShader(skinnedShader, [&]() {
+            BoneBuffer::setupShader(skinnedShader);
+        });
+        if (indirectShader) assets.addShader(*indirectShader);
+        assets.addModel(model, [&]() {
+            world.refreshModel(modelHandle);
+            sceneBvh.build(world, &jobs);
+            if (gpuScene) gpuScene->build();
+            setupAnimation();
+        });
 
         //  
         glm::vec3 lightPos(5.0f, 10.0f, 5.0f);
@@ -42,44 +119,149 @@ int main() {
         std::cout << "Engine started successfully!" << std::endl;
         std::cout << "Controls: WASD - move, Mouse - look, Scroll - zoom"
             << std::endl;
+        std::cout << "F1/F2/F3 - no AA/MSAA 4x/FXAA, "
+            "F4/F5 - dynamic resolution on/off" << std::endl;
+        std::cout << "Left click - pick the object at the screen center"
+            << std::endl;
+        std::cout << "F6/F7 - GPU-driven / CPU meshlet culling" << std::endl;
+        std::cout << "Shaders, models and textures reload when saved"
+            << std::endl;
+
+        // Meshlet rejection rates of the CPU path, printed every second
+        ClusterStats clusterStats;
+        int statsFrames = 0;
+        float statsTime = 0.0f;
+
+#ifdef VENGINE_ALLOCATION_CHECK
+        // Phase 0: GPU-driven path, phase 1: CPU meshlet path
+        AllocationCheck allocationCheck(2);
+#endif
 
         //  
         while (!window.shouldClose()) {
+#ifdef VENGINE_ALLOCATION_CHECK
+            int checkPhase = allocationCheck.beginFrame();
+            if (checkPhase < 0) break;
+            gpuDriven = checkPhase == 0;
+#endif
+
             // Delta time
             float currentFrame = static_cast<float>(glfwGetTime());
             deltaTime = currentFrame - lastFrame;
             lastFrame = currentFrame;
 
             // 
-            processInput(window.getHandle());
+            processInput(window.getHandle(), resolution);
+
+            resolution.beginFrame(window.getWidth(), window.getHeight());
 
             //  
             glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-            //  
-            shader.use();
+            frameArena.reset();
+            assets.update();
+
+            //   ()
+            glm::vec3 rotation = world.getRotation(entity);
+            rotation.y += 20.0f * deltaTime;
+            world.setRotation(entity, rotation);
+            world.updateTransforms(&jobs);
+            sceneBvh.refit(world, &jobs);
+
+            bool skinned = animated >= 0;
+            if (skinned) {
+                animator.update(deltaTime, &jobs);
+                boneBuffer.upload(animator);
+            }
+
+            // The cursor is captured, so picking goes through the center
+            bool pick = glfwGetMouseButton(window.getHandle(),
+                GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+            if (pick && !pickHeld) {
+                Ray ray = { camera.position, glm::normalize(camera.front) };
+                SceneHit hit;
+                if (sceneBvh.raycast(ray, 1000.0f, hit)) {
+                    std::cout << "Picked entity " << hit.entity
+                        << ", mesh " << hit.mesh << ", triangle "
+                        << hit.triangle << " at " << hit.distance
+                        << std::endl;
+                }
+            }
+            pickHeld = pick;
 
             //  
             glm::mat4 view = camera.getViewMatrix();
             glm::mat4 projection = camera.getProjectionMatrix(
                 window.getAspectRatio());
 
-            shader.setMat4("view", view);
-            shader.setMat4("projection", projection);
+            // Culling pass runs before the draw shader is bound
+            bool useGpuScene = !skinned && gpuScene && gpuDriven;
+            if (useGpuScene) {
+                gpuScene->setTransform(0, world.getWorldMatrix(entity));
+                gpuScene->cull(projection * view);
+            }
+            Shader& activeShader = skinned ? skinnedShader
+                : useGpuScene ? *indirectShader : shader;
 
-            // 
-            shader.setVec3("lightPos", lightPos);
-            shader.setVec3("viewPos", camera.position);
-            shader.setVec3("lightColor", lightColor);
-            shader.setVec3("objectColor", glm::vec3(0.8f, 0.8f, 0.8f));
-            shader.setBool("useTexture", true);
+            //  
+            activeShader.use();
 
-            //   ()
-            model.rotation.y += 20.0f * deltaTime;
+            activeShader.setMat4("view", view);
+            activeShader.setMat4("projection", projection);
+
+            // 
+            activeShader.setVec3("lightPos", lightPos);
+            activeShader.setVec3("viewPos", camera.position);
+            activeShader.setVec3("lightColor", lightColor);
+            activeShader.setVec3("objectColor", glm::vec3(0.8f, 0.8f, 0.8f));
+            activeShader.setBool("useTexture", true);
 
             //  
-            model.draw(shader);
+            if (skinned) {
+                // Skinned vertices leave the meshlet bounds: no culling
+                glm::mat4 modelMatrix = world.getWorldMatrix(entity);
+                boneBuffer.bind(animated);
+                model.draw(activeShader, modelMatrix, glm::transpose(
+                    glm::inverse(glm::mat3(modelMatrix))));
+                boneBuffer.endFrame();
+            }
+            else if (useGpuScene) {
+                gpuScene->draw(activeShader);
+            }
+            else {
+                Frustum frustum = Frustum::fromMatrix(projection * view);
+                FrameList<Entity> visible = world.cull(
+                    frustum, frameArena, &jobs);
+                FrameList<uint64_t> drawList = world.buildDrawList(
+                    visible, camera.position, frameArena, &jobs);
+                clusterStats.add(world.drawClusters(drawList, frustum,
+                    camera.position, shader, frameArena, &jobs));
+                statsFrames++;
+            }
+            // Fences the transforms of this frame's cull, if any
+            if (gpuScene) gpuScene->endFrame();
+
+            if (currentFrame - statsTime >= 1.0f) {
+                if (statsFrames > 0 && clusterStats.clusters > 0) {
+                    double clusters = (double)clusterStats.clusters;
+                    std::cout << "Meshlets/frame: "
+                        << clusterStats.clusters / statsFrames
+                        << ", rejected: frustum "
+                        << 100.0 * clusterStats.frustumCulled / clusters
+                        << "%, back-facing "
+                        << 100.0 * clusterStats.backfaceCulled / clusters
+                        << "%, triangles "
+                        << 100.0 * clusterStats.trianglesCulled
+                        / clusterStats.triangles << "%" << std::endl;
+                }
+                clusterStats = ClusterStats();
+                statsFrames = 0;
+                statsTime = currentFrame;
+            }
+
+            //   
+            resolution.endFrame();
 
             // Swap buffers
             window.swapBuffers();
@@ -88,6 +270,10 @@ int main() {
 
         model.cleanup();
 
+#ifdef VENGINE_ALLOCATION_CHECK
+        return allocationCheck.report();
+#endif
+
     }
     catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -97,10 +283,25 @@ int main() {
     return 0;
 }
 
-void processInput(GLFWwindow* window) {
+void processInput(GLFWwindow* window, DynamicResolution& resolution) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
+    if (glfwGetKey(window, GLFW_KEY_F1) == GLFW_PRESS)
+        resolution.setAntiAliasing(AntiAliasing::None);
+    if (glfwGetKey(window, GLFW_KEY_F2) == GLFW_PRESS)
+        resolution.setAntiAliasing(AntiAliasing::MSAA, 4);
+    if (glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS)
+        resolution.setAntiAliasing(AntiAliasing::FXAA);
+    if (glfwGetKey(window, GLFW_KEY_F4) == GLFW_PRESS)
+        resolution.setEnabled(true);
+    if (glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS)
+        resolution.setEnabled(false);
+    if (glfwGetKey(window, GLFW_KEY_F6) == GLFW_PRESS)
+        gpuDriven = true;
+    if (glfwGetKey(window, GLFW_KEY_F7) == GLFW_PRESS)
+        gpuDriven = false;
+
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         camera.processKeyboard(0, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)